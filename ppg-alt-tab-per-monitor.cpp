@@ -21,10 +21,180 @@ is currently located, showing only the windows present on that specific monitor.
 */
 // ==/WindhawkModReadme==
 
+// ==WindhawkModSettings==
+/*
+- traceDumpHotkey: ""
+  $name: Trace dump hotkey
+  $description: >-
+    Logs how long the mod spent in each hook during the last Alt+Tab sessions,
+    and how many windows it kept or filtered out. Format: Modifiers+Key, e.g.
+    Ctrl+Shift+Alt+F12. Leave empty to disable.
+- logLevel: info
+  $name: Log level
+  $description: >-
+    How much the mod logs while it runs. Every hook call is only logged by
+    builds compiled with -DLOG_MAX_LEVEL=3.
+  $options:
+  - error: Errors only
+  - info: Actions
+  - trace: Every hook call
+*/
+// ==/WindhawkModSettings==
+
 #include <windhawk_utils.h>
 
 #include <winrt/windows.foundation.collections.h>
 
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define WM_APP_RELOAD_SETTINGS (WM_APP + 1)
+#define WM_APP_SESSION_CHANGED (WM_APP + 2)
+
+struct {
+    UINT traceDumpModifiers;
+    UINT traceDumpVk;
+} g_settings;
+
+// Hot-path logging. LOG_TRACE compiles out unless the mod is built with
+// -DLOG_MAX_LEVEL=3 in @compilerOptions, and the levels that are compiled in
+// are gated at runtime by the logLevel setting. Messages are formatted on the
+// calling thread and written by a logger thread, so a hooked shell thread
+// never waits for Wh_Log.
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_TRACE 3
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_AT(level, message, ...)                                        \
+    do {                                                                   \
+        if ((level) <= g_logLevel.load(std::memory_order_relaxed)) {       \
+            LogWrite(__FUNCTION__, message, ##__VA_ARGS__);                \
+        }                                                                  \
+    } while (0)
+
+#define LOG_ERROR(message, ...) LOG_AT(LOG_LEVEL_ERROR, message, ##__VA_ARGS__)
+
+#if LOG_MAX_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(message, ...) LOG_AT(LOG_LEVEL_INFO, message, ##__VA_ARGS__)
+#else
+#define LOG_INFO(message, ...) \
+    do {                       \
+    } while (0)
+#endif
+
+#if LOG_MAX_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(message, ...) LOG_AT(LOG_LEVEL_TRACE, message, ##__VA_ARGS__)
+#else
+#define LOG_TRACE(message, ...) \
+    do {                        \
+    } while (0)
+#endif
+
+// Lines beyond this many waiting for the logger thread are dropped.
+constexpr size_t kLogQueueLimit = 1024;
+
+std::atomic<int> g_logLevel{LOG_LEVEL_INFO};
+std::mutex g_logMutex;
+std::vector<std::wstring> g_logQueue;
+size_t g_logDropped;
+HANDLE g_logEvent;
+HANDLE g_logThread;
+std::atomic<bool> g_logStopping;
+
+void LogWrite(const char* function, PCWSTR format, ...) {
+    thread_local WCHAR buffer[1024];
+
+    int prefixLength =
+        _snwprintf(buffer, ARRAYSIZE(buffer) - 1, L"[%hs] ", function);
+    if (prefixLength < 0) {
+        prefixLength = 0;
+    }
+
+    va_list args;
+    va_start(args, format);
+    _vsnwprintf(buffer + prefixLength, ARRAYSIZE(buffer) - 1 - prefixLength,
+                format, args);
+    va_end(args);
+    buffer[ARRAYSIZE(buffer) - 1] = L'\0';
+
+    {
+        std::lock_guard<std::mutex> guard(g_logMutex);
+        if (g_logQueue.size() >= kLogQueueLimit) {
+            g_logDropped++;
+            return;
+        }
+
+        g_logQueue.emplace_back(buffer);
+    }
+
+    SetEvent(g_logEvent);
+}
+
+DWORD WINAPI LogThreadProc(LPVOID lpParameter) {
+    std::vector<std::wstring> lines;
+    while (true) {
+        WaitForSingleObject(g_logEvent, INFINITE);
+        bool stopping = g_logStopping;
+
+        size_t dropped;
+        {
+            std::lock_guard<std::mutex> guard(g_logMutex);
+            lines.swap(g_logQueue);
+            dropped = g_logDropped;
+            g_logDropped = 0;
+        }
+
+        for (const auto& line : lines) {
+            Wh_Log(L"%s", line.c_str());
+        }
+        lines.clear();
+
+        if (dropped) {
+            Wh_Log(L"Dropped %zu log lines", dropped);
+        }
+
+        if (stopping) {
+            return 0;
+        }
+    }
+}
+
+void StartLogThread() {
+    g_logEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    g_logThread = CreateThread(nullptr, 0, LogThreadProc, nullptr, 0, nullptr);
+}
+
+// Writes whatever is still queued before returning.
+void StopLogThread() {
+    if (g_logThread) {
+        g_logStopping = true;
+        SetEvent(g_logEvent);
+        WaitForSingleObject(g_logThread, INFINITE);
+        CloseHandle(g_logThread);
+        g_logThread = nullptr;
+    }
+
+    if (g_logEvent) {
+        CloseHandle(g_logEvent);
+        g_logEvent = nullptr;
+    }
+}
+
+int ParseLogLevel(PCWSTR logLevel) {
+    if (wcscmp(logLevel, L"error") == 0) {
+        return LOG_LEVEL_ERROR;
+    } else if (wcscmp(logLevel, L"trace") == 0) {
+        return LOG_LEVEL_TRACE;
+    }
+    return LOG_LEVEL_INFO;
+}
+
 enum class WinVersion {
     Unsupported,
     Win10,
@@ -34,10 +204,189 @@ enum class WinVersion {
 WinVersion g_winVersion;
 
 std::atomic<DWORD> g_threadIdForAltTabShowWindow;
-std::atomic<DWORD> g_lastThreadIdForXamlAltTabViewHost_CreateInstance;
-std::atomic<DWORD> g_threadIdForXamlAltTabViewHost_CreateInstance;
-ULONGLONG g_CreateInstance_TickCount;
-constexpr ULONGLONG kDeltaThreshold = 200;
+
+// An Alt+Tab session lasts from the creation of the switcher until the user
+// releases Alt+Tab. IsViewVisible also serves Win+Tab and the taskbar, so views
+// are only filtered while a session is open, and only on the thread that
+// created the switcher. A session ends on EVENT_SYSTEM_SWITCHEND, or when the
+// top-level window its thread showed is hidden or destroyed. In case neither
+// is seen, it also has a deadline: the baseline 200 ms if the end event isn't
+// being tracked, and a few seconds otherwise, renewed while Alt is held.
+struct AltTabSession {
+    std::atomic<unsigned> id;  // 0 while no switcher is open
+    std::atomic<DWORD> threadId;
+    std::atomic<DWORD> beginTickCount;
+    std::atomic<ULONGLONG> deadlineTickCount;
+    // The monitor the cursor was on when the session began. Every view of the
+    // session is filtered against it, so the list doesn't change if the cursor
+    // moves while the switcher is still enumerating.
+    std::atomic<HMONITOR> cursorMonitor;
+};
+
+AltTabSession g_altTabSession;
+std::atomic<unsigned> g_lastAltTabSessionId;
+std::atomic<bool> g_switchEndTracked;
+
+constexpr ULONGLONG kUntrackedSessionDuration = 200;
+constexpr ULONGLONG kMaxSessionDuration = 3 * 1000;
+
+HANDLE g_sessionEventThread;
+DWORD g_sessionEventThreadId;
+
+// Tracing: every session counts the calls into the hooks and splits their time
+// between the mod and the original function. Closed sessions go to a ring that
+// the trace dump hotkey logs. Outside a session, IsViewVisible isn't traced.
+enum TraceHook {
+    TRACE_IS_VIEW_VISIBLE,
+    TRACE_XAML_SHOW,
+    TRACE_SHOW,
+    TRACE_POSITION,
+    TRACE_CREATE_FRAME,
+    TRACE_HOOK_COUNT,
+};
+
+constexpr const wchar_t* kTraceHookNames[TRACE_HOOK_COUNT] = {
+    L"CVirtualDesktop::IsViewVisible",
+    L"XamlAltTabViewHost::Show",
+    L"CAltTabViewHost::Show",
+    L"ITaskGroupWindowInformation::Position",
+    L"CMultitaskingViewFrame::CreateFrame",
+};
+
+struct HookCounters {
+    ULONGLONG calls;
+    LONGLONG totalTicks;
+    LONGLONG originalTicks;
+};
+
+struct SessionTrace {
+    unsigned id;
+    LONGLONG durationTicks;
+    ULONGLONG viewsKept;
+    ULONGLONG viewsFiltered;
+    HookCounters hooks[TRACE_HOOK_COUNT];
+};
+
+// Counters of the open session. Hooks may run on several threads.
+struct {
+    std::atomic<LONGLONG> beginTicks;
+    std::atomic<ULONGLONG> viewsKept;
+    std::atomic<ULONGLONG> viewsFiltered;
+    struct {
+        std::atomic<ULONGLONG> calls;
+        std::atomic<LONGLONG> totalTicks;
+        std::atomic<LONGLONG> originalTicks;
+    } hooks[TRACE_HOOK_COUNT];
+} g_liveTrace;
+
+constexpr size_t kTraceRingSize = 16;
+
+std::mutex g_traceRingMutex;
+SessionTrace g_traceRing[kTraceRingSize];
+size_t g_traceRingNext;
+size_t g_traceRingCount;
+
+LONGLONG QpcNow() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+LONGLONG QpcToMicroseconds(LONGLONG ticks) {
+    static const LONGLONG frequency = [] {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart;
+    }();
+    return ticks * 1000000 / frequency;
+}
+
+// Times one call into a hook; calls to the original go through Original so
+// that their time is told apart from the mod's.
+class HookTraceScope {
+   public:
+    explicit HookTraceScope(TraceHook hook) : hook(hook), start(QpcNow()) {}
+
+    ~HookTraceScope() {
+        auto& counters = g_liveTrace.hooks[hook];
+        counters.calls.fetch_add(1, std::memory_order_relaxed);
+        counters.totalTicks.fetch_add(QpcNow() - start,
+                                      std::memory_order_relaxed);
+        counters.originalTicks.fetch_add(originalTicks,
+                                         std::memory_order_relaxed);
+    }
+
+    template <typename Call>
+    HRESULT Original(Call&& call) {
+        LONGLONG originalStart = QpcNow();
+        HRESULT hr = call();
+        originalTicks += QpcNow() - originalStart;
+        return hr;
+    }
+
+   private:
+    TraceHook hook;
+    LONGLONG start;
+    LONGLONG originalTicks = 0;
+};
+
+void ResetLiveTrace() {
+    g_liveTrace.beginTicks = QpcNow();
+    g_liveTrace.viewsKept = 0;
+    g_liveTrace.viewsFiltered = 0;
+    for (auto& counters : g_liveTrace.hooks) {
+        counters.calls = 0;
+        counters.totalTicks = 0;
+        counters.originalTicks = 0;
+    }
+}
+
+void RecordSessionTrace(unsigned sessionId) {
+    SessionTrace trace;
+    trace.id = sessionId;
+    trace.durationTicks = QpcNow() - g_liveTrace.beginTicks;
+    trace.viewsKept = g_liveTrace.viewsKept;
+    trace.viewsFiltered = g_liveTrace.viewsFiltered;
+    for (int i = 0; i < TRACE_HOOK_COUNT; i++) {
+        trace.hooks[i].calls = g_liveTrace.hooks[i].calls;
+        trace.hooks[i].totalTicks = g_liveTrace.hooks[i].totalTicks;
+        trace.hooks[i].originalTicks = g_liveTrace.hooks[i].originalTicks;
+    }
+
+    std::lock_guard<std::mutex> guard(g_traceRingMutex);
+    g_traceRing[g_traceRingNext] = trace;
+    g_traceRingNext = (g_traceRingNext + 1) % kTraceRingSize;
+    if (g_traceRingCount < kTraceRingSize) {
+        g_traceRingCount++;
+    }
+}
+
+void DumpSessionTraces() {
+    std::lock_guard<std::mutex> guard(g_traceRingMutex);
+    Wh_Log(L"Last %zu Alt+Tab sessions, oldest first:", g_traceRingCount);
+    for (size_t n = 0; n < g_traceRingCount; n++) {
+        const SessionTrace& trace =
+            g_traceRing[(g_traceRingNext + kTraceRingSize - g_traceRingCount +
+                         n) %
+                        kTraceRingSize];
+        Wh_Log(L"Session %u: open for %lld ms, %llu views kept, %llu filtered",
+               trace.id, QpcToMicroseconds(trace.durationTicks) / 1000,
+               trace.viewsKept, trace.viewsFiltered);
+        for (int i = 0; i < TRACE_HOOK_COUNT; i++) {
+            const HookCounters& counters = trace.hooks[i];
+            if (!counters.calls) {
+                continue;
+            }
+
+            Wh_Log(L"  %s: %llu calls, %lld us in the mod, %lld us in the "
+                   L"original",
+                   kTraceHookNames[i], counters.calls,
+                   QpcToMicroseconds(counters.totalTicks -
+                                     counters.originalTicks),
+                   QpcToMicroseconds(counters.originalTicks));
+        }
+    }
+}
 
 VS_FIXEDFILEINFO* GetModuleVersionInfo(HMODULE hModule, UINT* puPtrLen) {
     void* pFixedFileInfo = nullptr;
@@ -92,13 +441,20 @@ WinVersion GetWindowsVersion() {
     return WinVersion::Unsupported;
 }
 
-bool HandleAltTabWindow(RECT* rect) {
+HMONITOR GetCursorMonitor() {
     POINT pt;
     if (!GetCursorPos(&pt)) {
-        return false;
+        return nullptr;
     }
 
-    auto hMon = MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
+    return MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
+}
+
+bool HandleAltTabWindow(RECT* rect) {
+    auto hMon = GetCursorMonitor();
+    if (!hMon) {
+        return false;
+    }
 
     MONITORINFO monInfo;
     monInfo.cbSize = sizeof(MONITORINFO);
@@ -140,17 +496,122 @@ HRESULT GetWindowHandleFromApplicationView(void* applicationView,
     return hr;
 }
 
-bool IsWindowOnCursorMonitor(HWND windowHandle) {
-    POINT pt;
-    if (!GetCursorPos(&pt)) {
-        return false;
+// Open-addressing map keyed by a pointer or handle, filled as the switcher
+// asks about each view. The switcher filters the same views several times per
+// session, so only the first query pays for the real lookup. Keys are never
+// null, which marks a free slot.
+template <typename Key, typename Value>
+class PointerMap {
+   public:
+    void Clear() {
+        slots.clear();
+        count = 0;
+    }
+
+    bool Find(Key key, Value* value) const {
+        if (slots.empty()) {
+            return false;
+        }
+
+        size_t mask = slots.size() - 1;
+        for (size_t i = Hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i].key == key) {
+                *value = slots[i].value;
+                return true;
+            }
+            if (!slots[i].key) {
+                return false;
+            }
+        }
     }
 
-    auto hMon = MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
-    auto hMonFromWindow =
-        MonitorFromWindow(windowHandle, MONITOR_DEFAULTTONEAREST);
+    void Insert(Key key, Value value) {
+        // Keep the load factor under one half.
+        if ((count + 1) * 2 > slots.size()) {
+            std::vector<Slot> old(slots.empty() ? 64 : slots.size() * 2);
+            old.swap(slots);
+            count = 0;
+            for (const Slot& slot : old) {
+                if (slot.key) {
+                    Insert(slot.key, slot.value);
+                }
+            }
+        }
+
+        size_t mask = slots.size() - 1;
+        size_t i = Hash(key) & mask;
+        while (slots[i].key && slots[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        if (!slots[i].key) {
+            count++;
+        }
+        slots[i] = {key, value};
+    }
+
+   private:
+    struct Slot {
+        Key key;
+        Value value;
+    };
+
+    static size_t Hash(Key key) {
+        // Handles are small and heap pointers aligned; spread them over the
+        // table.
+        return (size_t)(((UINT_PTR)key * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
 
-    return hMon == hMonFromWindow;
+// The views the current session has already resolved. Each thread that
+// filters views keeps its own cache, so lookups take no lock; a cache left
+// over from an earlier session is dropped on first use, as its views may have
+// been freed since.
+struct SessionCache {
+    unsigned sessionId = 0;
+    PointerMap<void*, HWND> viewWindows;
+};
+
+thread_local SessionCache t_sessionCache;
+
+SessionCache& GetSessionCache(unsigned sessionId) {
+    if (t_sessionCache.sessionId != sessionId) {
+        t_sessionCache.viewWindows.Clear();
+        t_sessionCache.sessionId = sessionId;
+    }
+
+    return t_sessionCache;
+}
+
+HWND GetSessionViewWindow(SessionCache& cache, void* applicationView) {
+    HWND windowHandle;
+    if (cache.viewWindows.Find(applicationView, &windowHandle)) {
+        return windowHandle;
+    }
+
+    HRESULT hr =
+        GetWindowHandleFromApplicationView(applicationView, &windowHandle);
+    if (FAILED(hr) || !windowHandle) {
+        return nullptr;
+    }
+
+    cache.viewWindows.Insert(applicationView, windowHandle);
+    return windowHandle;
+}
+
+// Ends the session `sessionId` if it's still the open one.
+void EndAltTabSession(unsigned sessionId) {
+    if (sessionId && g_altTabSession.id.compare_exchange_strong(
+                         sessionId, 0, std::memory_order_acq_rel)) {
+        RecordSessionTrace(sessionId);
+        PostThreadMessage(g_sessionEventThreadId, WM_APP_SESSION_CHANGED, 0, 0);
+    }
+}
+
+void EndAltTabSession() {
+    EndAltTabSession(g_altTabSession.id.load(std::memory_order_acquire));
 }
 
 using CVirtualDesktop_IsViewVisible_t = HRESULT(WINAPI*)(void* pThis,
@@ -160,39 +621,66 @@ CVirtualDesktop_IsViewVisible_t CVirtualDesktop_IsViewVisible_Original;
 HRESULT WINAPI CVirtualDesktop_IsViewVisible_Hook(void* pThis,
                                                   void* applicationView,
                                                   BOOL* isVisible) {
-    Wh_Log(L">");
-    auto ret = CVirtualDesktop_IsViewVisible_Original(pThis, applicationView,
+    LOG_TRACE(L">");
+    // Win+Tab and the taskbar call in here outside of any session.
+    if (!g_altTabSession.id.load(std::memory_order_relaxed)) {
+        return CVirtualDesktop_IsViewVisible_Original(pThis, applicationView,
                                                       isVisible);
+    }
+
+    HookTraceScope trace(TRACE_IS_VIEW_VISIBLE);
+    auto ret = trace.Original([&] {
+        return CVirtualDesktop_IsViewVisible_Original(pThis, applicationView,
+                                                      isVisible);
+    });
     if (FAILED(ret)) {
         return ret;
     }
 
-    if (g_threadIdForXamlAltTabViewHost_CreateInstance !=
-        GetCurrentThreadId()) {
-        // A focused window might be added after a short period. Filter windows
-        // using our monitor rules if the alt tab window was just opened.
-        // Otherwise, don't play with the filter anymore, as it's also used by
-        // other components such as Win+Tab and the taskbar.
-        if ((GetTickCount64() - g_CreateInstance_TickCount) > kDeltaThreshold ||
-            g_lastThreadIdForXamlAltTabViewHost_CreateInstance !=
-                GetCurrentThreadId()) {
+    unsigned sessionId = g_altTabSession.id.load(std::memory_order_acquire);
+    if (!sessionId) {
+        return ret;
+    }
+
+    ULONGLONG now = GetTickCount64();
+    if (now >
+        g_altTabSession.deadlineTickCount.load(std::memory_order_relaxed)) {
+        // A switcher held open past its deadline keeps its session, unless
+        // the end of Alt+Tab isn't tracked at all.
+        if (!g_switchEndTracked || GetAsyncKeyState(VK_MENU) >= 0) {
+            EndAltTabSession(sessionId);
             return ret;
         }
+        g_altTabSession.deadlineTickCount.store(now + kMaxSessionDuration,
+                                                std::memory_order_relaxed);
+    }
+
+    if (g_altTabSession.threadId.load(std::memory_order_relaxed) !=
+        GetCurrentThreadId()) {
+        return ret;
     }
 
     if (!*isVisible) {
         return ret;
     }
 
-    HWND windowHandle;
-    HRESULT hr =
-        GetWindowHandleFromApplicationView(applicationView, &windowHandle);
+    HMONITOR sessionMonitor =
+        g_altTabSession.cursorMonitor.load(std::memory_order_relaxed);
+    if (!sessionMonitor) {
+        return ret;
+    }
 
-    if (FAILED(hr) || !windowHandle) {
+    SessionCache& cache = GetSessionCache(sessionId);
+    HWND windowHandle = GetSessionViewWindow(cache, applicationView);
+    if (!windowHandle) {
         return ret;
     }
 
-    if (!IsWindowOnCursorMonitor(windowHandle)) {
+    if (MonitorFromWindow(windowHandle, MONITOR_DEFAULTTONEAREST) ==
+        sessionMonitor) {
+        g_liveTrace.viewsKept.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        g_liveTrace.viewsFiltered.fetch_add(1, std::memory_order_relaxed);
         *isVisible = FALSE;
     }
 
@@ -208,9 +696,11 @@ HRESULT WINAPI XamlAltTabViewHost_Show_Hook(void* pThis,
                                             void* param1,
                                             int param2,
                                             void* param3) {
+    HookTraceScope trace(TRACE_XAML_SHOW);
     g_threadIdForAltTabShowWindow = GetCurrentThreadId();
-    HRESULT ret =
-        XamlAltTabViewHost_Show_Original(pThis, param1, param2, param3);
+    HRESULT ret = trace.Original([&] {
+        return XamlAltTabViewHost_Show_Original(pThis, param1, param2, param3);
+    });
     g_threadIdForAltTabShowWindow = 0;
     return ret;
 }
@@ -224,9 +714,12 @@ HRESULT WINAPI CAltTabViewHost_Show_Hook(void* pThis,
                                          void* param1,
                                          int param2,
                                          void* param3) {
-    Wh_Log(L">");
+    LOG_TRACE(L">");
+    HookTraceScope trace(TRACE_SHOW);
     g_threadIdForAltTabShowWindow = GetCurrentThreadId();
-    HRESULT ret = CAltTabViewHost_Show_Original(pThis, param1, param2, param3);
+    HRESULT ret = trace.Original([&] {
+        return CAltTabViewHost_Show_Original(pThis, param1, param2, param3);
+    });
     g_threadIdForAltTabShowWindow = 0;
     return ret;
 }
@@ -243,9 +736,12 @@ HRESULT WINAPI ITaskGroupWindowInformation_Position_Hook(
     }
     g_threadIdForAltTabShowWindow = 0;
 
+    HookTraceScope trace(TRACE_POSITION);
     RECT newRectNative;
     if (!HandleAltTabWindow(&newRectNative)) {
-        return ITaskGroupWindowInformation_Position_Original(pThis, rect);
+        return trace.Original([&] {
+            return ITaskGroupWindowInformation_Position_Original(pThis, rect);
+        });
     }
 
     winrt::Windows::Foundation::Rect newRect{
@@ -255,8 +751,9 @@ HRESULT WINAPI ITaskGroupWindowInformation_Position_Hook(
         static_cast<float>(newRectNative.bottom - newRectNative.top),
     };
 
-    HRESULT ret =
-        ITaskGroupWindowInformation_Position_Original(pThis, &newRect);
+    HRESULT ret = trace.Original([&] {
+        return ITaskGroupWindowInformation_Position_Original(pThis, &newRect);
+    });
 
     return ret;
 }
@@ -274,17 +771,400 @@ HRESULT WINAPI CMultitaskingViewFrame_CreateFrame_Hook(void* pThis,
     }
     g_threadIdForAltTabShowWindow = 0;
 
+    HookTraceScope trace(TRACE_CREATE_FRAME);
     RECT newRect;
     if (!HandleAltTabWindow(&newRect)) {
-        return CMultitaskingViewFrame_CreateFrame_Original(pThis, rect, param2);
+        return trace.Original([&] {
+            return CMultitaskingViewFrame_CreateFrame_Original(pThis, rect,
+                                                               param2);
+        });
     }
 
-    HRESULT ret =
-        CMultitaskingViewFrame_CreateFrame_Original(pThis, &newRect, param2);
+    HRESULT ret = trace.Original([&] {
+        return CMultitaskingViewFrame_CreateFrame_Original(pThis, &newRect,
+                                                           param2);
+    });
 
     return ret;
 }
 
+// Called as the switcher is created, before it asks which views to show. A
+// session that was never closed is replaced.
+void BeginAltTabSession() {
+    EndAltTabSession();
+    ResetLiveTrace();
+    g_altTabSession.threadId.store(GetCurrentThreadId(),
+                                   std::memory_order_relaxed);
+    g_altTabSession.beginTickCount.store(GetTickCount(),
+                                         std::memory_order_relaxed);
+    g_altTabSession.deadlineTickCount.store(
+        GetTickCount64() + (g_switchEndTracked ? kMaxSessionDuration
+                                               : kUntrackedSessionDuration),
+        std::memory_order_relaxed);
+    g_altTabSession.cursorMonitor.store(GetCursorMonitor(),
+                                        std::memory_order_relaxed);
+    g_altTabSession.id.store(g_lastAltTabSessionId.fetch_add(1) + 1,
+                             std::memory_order_release);
+    PostThreadMessage(g_sessionEventThreadId, WM_APP_SESSION_CHANGED, 0, 0);
+}
+
+void CALLBACK SwitchEndEventProc(HWINEVENTHOOK hWinEventHook,
+                                 DWORD event,
+                                 HWND hwnd,
+                                 LONG idObject,
+                                 LONG idChild,
+                                 DWORD idEventThread,
+                                 DWORD dwmsEventTime) {
+    unsigned sessionId = g_altTabSession.id.load(std::memory_order_acquire);
+
+    // Out-of-context events arrive late. One raised before the open session
+    // began was meant for an earlier one.
+    if ((LONG)(dwmsEventTime - g_altTabSession.beginTickCount.load(
+                                   std::memory_order_relaxed)) < 0) {
+        return;
+    }
+
+    EndAltTabSession(sessionId);
+}
+
+// Only touched on the session event thread.
+HWINEVENTHOOK g_switcherHook;
+DWORD g_switcherHookThreadId;
+unsigned g_switcherSessionId;
+HWND g_switcherWindow;
+
+// Sees the switcher thread's windows while a session is open. The top-level
+// window the thread shows is taken as the switcher, and the session ends when
+// that window is hidden or destroyed, even if EVENT_SYSTEM_SWITCHEND is
+// missed.
+void CALLBACK SwitcherWindowEventProc(HWINEVENTHOOK hWinEventHook,
+                                      DWORD event,
+                                      HWND hwnd,
+                                      LONG idObject,
+                                      LONG idChild,
+                                      DWORD idEventThread,
+                                      DWORD dwmsEventTime) {
+    if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hwnd) {
+        return;
+    }
+
+    unsigned sessionId = g_altTabSession.id.load(std::memory_order_acquire);
+    if (!sessionId ||
+        (LONG)(dwmsEventTime - g_altTabSession.beginTickCount.load(
+                                   std::memory_order_relaxed)) < 0) {
+        return;
+    }
+
+    if (event == EVENT_OBJECT_SHOW) {
+        if (GetAncestor(hwnd, GA_ROOT) == hwnd) {
+            g_switcherWindow = hwnd;
+        }
+    } else if (hwnd == g_switcherWindow) {
+        g_switcherWindow = nullptr;
+        EndAltTabSession(sessionId);
+    }
+}
+
+// Hooks the windows of the open session's thread, and nothing while no
+// session is open. The hook is scoped to that one thread of explorer, so it
+// sees only the switcher's own window traffic.
+void SyncSwitcherHook() {
+    unsigned sessionId = g_altTabSession.id.load(std::memory_order_acquire);
+    DWORD threadId =
+        sessionId ? g_altTabSession.threadId.load(std::memory_order_relaxed)
+                  : 0;
+    if (sessionId != g_switcherSessionId) {
+        g_switcherSessionId = sessionId;
+        g_switcherWindow = nullptr;
+    }
+
+    if (g_switcherHook && g_switcherHookThreadId == threadId) {
+        return;
+    }
+
+    if (g_switcherHook) {
+        UnhookWinEvent(g_switcherHook);
+        g_switcherHook = nullptr;
+    }
+    g_switcherHookThreadId = threadId;
+    if (!threadId) {
+        return;
+    }
+
+    g_switcherHook = SetWinEventHook(
+        EVENT_OBJECT_DESTROY, EVENT_OBJECT_HIDE, nullptr,
+        SwitcherWindowEventProc, GetCurrentProcessId(), threadId,
+        WINEVENT_OUTOFCONTEXT);
+    if (!g_switcherHook) {
+        Wh_Log(L"SetWinEventHook failed: %u", GetLastError());
+    }
+}
+
+// The hotkey grammar of the PPG hotkey mods, copied verbatim so the trace
+// dump hotkey is written the same way as theirs. Only single-step hotkeys are
+// accepted here.
+// — Hotkey grammar —
+//
+// Windhawk builds every mod from a single file, so this section, chord
+// dispatch and the exclusion sets are carried verbatim by each PPG hotkey mod.
+// Change every copy together, so a hotkey string means the same key in all of
+// them.
+//
+// A hotkey is a chord of one or more comma-separated steps, each written as
+// Modifiers+Key, e.g. "Ctrl+Shift+Alt+F5" or "Ctrl+K, Ctrl+M". Key names are
+// looked up in kKeyNames; a single letter or digit names itself and "0xNN"
+// names any virtual-key code directly.
+
+struct KeyName {
+    const wchar_t* name;
+    UINT           vk;
+};
+
+static constexpr KeyName kKeyNames[] = {
+    { L"BACKSPACE", VK_BACK },          { L"BACK", VK_BACK },
+    { L"TAB", VK_TAB },                 { L"CLEAR", VK_CLEAR },
+    { L"ENTER", VK_RETURN },            { L"RETURN", VK_RETURN },
+    { L"PAUSE", VK_PAUSE },             { L"CAPSLOCK", VK_CAPITAL },
+    { L"ESC", VK_ESCAPE },              { L"ESCAPE", VK_ESCAPE },
+    { L"SPACE", VK_SPACE },
+    { L"PAGEUP", VK_PRIOR },            { L"PGUP", VK_PRIOR },
+    { L"PAGEDOWN", VK_NEXT },           { L"PGDN", VK_NEXT },
+    { L"END", VK_END },                 { L"HOME", VK_HOME },
+    { L"LEFT", VK_LEFT },               { L"UP", VK_UP },
+    { L"RIGHT", VK_RIGHT },             { L"DOWN", VK_DOWN },
+    { L"SELECT", VK_SELECT },           { L"PRINT", VK_PRINT },
+    { L"EXECUTE", VK_EXECUTE },
+    { L"PRINTSCREEN", VK_SNAPSHOT },    { L"PRTSC", VK_SNAPSHOT },
+    { L"INSERT", VK_INSERT },           { L"INS", VK_INSERT },
+    { L"DELETE", VK_DELETE },           { L"DEL", VK_DELETE },
+    { L"HELP", VK_HELP },
+    { L"APPS", VK_APPS },               { L"MENU", VK_APPS },
+    { L"SLEEP", VK_SLEEP },
+    { L"NUM0", VK_NUMPAD0 },            { L"NUM1", VK_NUMPAD1 },
+    { L"NUM2", VK_NUMPAD2 },            { L"NUM3", VK_NUMPAD3 },
+    { L"NUM4", VK_NUMPAD4 },            { L"NUM5", VK_NUMPAD5 },
+    { L"NUM6", VK_NUMPAD6 },            { L"NUM7", VK_NUMPAD7 },
+    { L"NUM8", VK_NUMPAD8 },            { L"NUM9", VK_NUMPAD9 },
+    { L"MULTIPLY", VK_MULTIPLY },       { L"ADD", VK_ADD },
+    { L"SEPARATOR", VK_SEPARATOR },     { L"SUBTRACT", VK_SUBTRACT },
+    { L"DECIMAL", VK_DECIMAL },         { L"DIVIDE", VK_DIVIDE },
+    { L"F1", VK_F1 },                   { L"F2", VK_F2 },
+    { L"F3", VK_F3 },                   { L"F4", VK_F4 },
+    { L"F5", VK_F5 },                   { L"F6", VK_F6 },
+    { L"F7", VK_F7 },                   { L"F8", VK_F8 },
+    { L"F9", VK_F9 },                   { L"F10", VK_F10 },
+    { L"F11", VK_F11 },                 { L"F12", VK_F12 },
+    { L"F13", VK_F13 },                 { L"F14", VK_F14 },
+    { L"F15", VK_F15 },                 { L"F16", VK_F16 },
+    { L"F17", VK_F17 },                 { L"F18", VK_F18 },
+    { L"F19", VK_F19 },                 { L"F20", VK_F20 },
+    { L"F21", VK_F21 },                 { L"F22", VK_F22 },
+    { L"F23", VK_F23 },                 { L"F24", VK_F24 },
+    { L"NUMLOCK", VK_NUMLOCK },         { L"SCROLLLOCK", VK_SCROLL },
+    { L"BROWSERBACK", VK_BROWSER_BACK },
+    { L"BROWSERFORWARD", VK_BROWSER_FORWARD },
+    { L"BROWSERREFRESH", VK_BROWSER_REFRESH },
+    { L"BROWSERSTOP", VK_BROWSER_STOP },
+    { L"BROWSERSEARCH", VK_BROWSER_SEARCH },
+    { L"BROWSERFAVORITES", VK_BROWSER_FAVORITES },
+    { L"BROWSERHOME", VK_BROWSER_HOME },
+    { L"VOLUMEMUTE", VK_VOLUME_MUTE },  { L"VOLUMEDOWN", VK_VOLUME_DOWN },
+    { L"VOLUMEUP", VK_VOLUME_UP },
+    { L"MEDIANEXT", VK_MEDIA_NEXT_TRACK },
+    { L"MEDIAPREV", VK_MEDIA_PREV_TRACK },
+    { L"MEDIASTOP", VK_MEDIA_STOP },
+    { L"MEDIAPLAYPAUSE", VK_MEDIA_PLAY_PAUSE },
+    { L"LAUNCHMAIL", VK_LAUNCH_MAIL },
+    { L"LAUNCHMEDIA", VK_LAUNCH_MEDIA_SELECT },
+    { L"LAUNCHAPP1", VK_LAUNCH_APP1 },  { L"LAUNCHAPP2", VK_LAUNCH_APP2 },
+    // OEM keys, named after their US-layout legends. "+" and "," separate
+    // steps, so those two keys are only reachable by name.
+    { L";", VK_OEM_1 },                 { L"SEMICOLON", VK_OEM_1 },
+    { L"=", VK_OEM_PLUS },              { L"PLUS", VK_OEM_PLUS },
+    { L"COMMA", VK_OEM_COMMA },
+    { L"-", VK_OEM_MINUS },             { L"MINUS", VK_OEM_MINUS },
+    { L".", VK_OEM_PERIOD },            { L"PERIOD", VK_OEM_PERIOD },
+    { L"/", VK_OEM_2 },                 { L"SLASH", VK_OEM_2 },
+    { L"`", VK_OEM_3 },                 { L"BACKTICK", VK_OEM_3 },
+    { L"[", VK_OEM_4 },                 { L"LBRACKET", VK_OEM_4 },
+    { L"\\", VK_OEM_5 },                { L"BACKSLASH", VK_OEM_5 },
+    { L"]", VK_OEM_6 },                 { L"RBRACKET", VK_OEM_6 },
+    { L"'", VK_OEM_7 },                 { L"QUOTE", VK_OEM_7 },
+    { L"OEM8", VK_OEM_8 },              { L"OEM102", VK_OEM_102 },
+};
+
+constexpr size_t kMaxChordSteps = 4;
+
+struct HotkeyStep {
+    UINT modifiers;
+    UINT vk;
+};
+
+struct HotkeyChord {
+    HotkeyStep steps[kMaxChordSteps];
+    size_t     count;
+};
+
+static wchar_t AsciiUpper(wchar_t c) {
+    return (c >= L'a' && c <= L'z') ? wchar_t(c - L'a' + L'A') : c;
+}
+
+static bool EqualsNoCase(std::wstring_view a, const wchar_t* b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i) {
+        if (AsciiUpper(a[i]) != AsciiUpper(b[i])) return false;
+    }
+    return i == a.size() && !b[i];
+}
+
+static std::wstring_view TrimSpaces(std::wstring_view s) {
+    while (!s.empty() && s.front() == L' ') s.remove_prefix(1);
+    while (!s.empty() && s.back() == L' ')  s.remove_suffix(1);
+    return s;
+}
+
+static UINT LookupModifier(std::wstring_view tok) {
+    if (EqualsNoCase(tok, L"SHIFT"))                                 return MOD_SHIFT;
+    if (EqualsNoCase(tok, L"CTRL") || EqualsNoCase(tok, L"CONTROL")) return MOD_CONTROL;
+    if (EqualsNoCase(tok, L"ALT"))                                   return MOD_ALT;
+    if (EqualsNoCase(tok, L"WIN") || EqualsNoCase(tok, L"WINDOWS"))  return MOD_WIN;
+    return 0;
+}
+
+static UINT LookupKey(std::wstring_view tok) {
+    if (tok.size() == 1) {
+        wchar_t c = AsciiUpper(tok[0]);
+        if ((c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9')) return c;
+    }
+    if (tok.size() > 2 && tok[0] == L'0' && AsciiUpper(tok[1]) == L'X') {
+        UINT vk = 0;
+        for (size_t i = 2; i < tok.size(); ++i) {
+            wchar_t c = AsciiUpper(tok[i]);
+            if (c >= L'0' && c <= L'9')      vk = vk * 16 + (c - L'0');
+            else if (c >= L'A' && c <= L'F') vk = vk * 16 + (c - L'A' + 10);
+            else return 0;
+            if (vk > 0xFE) return 0;
+        }
+        return vk;
+    }
+    for (const auto& key : kKeyNames) {
+        if (EqualsNoCase(tok, key.name)) return key.vk;
+    }
+    return 0;
+}
+
+// Parse a single Modifiers+Key step. Unknown modifiers or keys fail the
+// whole step instead of being dropped.
+static bool ParseHotkeyStep(std::wstring_view s, HotkeyStep& step) {
+    step = {};
+    for (size_t pos; (pos = s.find(L'+')) != std::wstring_view::npos; s.remove_prefix(pos + 1)) {
+        UINT mod = LookupModifier(TrimSpaces(s.substr(0, pos)));
+        if (!mod) return false;
+        step.modifiers |= mod;
+    }
+    step.vk = LookupKey(TrimSpaces(s));
+    return step.vk != 0;
+}
+
+// Split a L"Mod1+Mod2+Key, Mod1+Key" string into chord steps
+bool ParseHotkey(std::wstring_view s, HotkeyChord& chord) {
+    chord = {};
+    while (chord.count < kMaxChordSteps) {
+        size_t pos = s.find(L',');
+        if (!ParseHotkeyStep(s.substr(0, pos), chord.steps[chord.count])) return false;
+        chord.count++;
+        if (pos == std::wstring_view::npos) return true;
+        s.remove_prefix(pos + 1);
+    }
+    return false;
+}
+
+void LoadSettings() {
+    g_settings.traceDumpModifiers = 0;
+    g_settings.traceDumpVk = 0;
+    PCWSTR traceDumpHotkey = Wh_GetStringSetting(L"traceDumpHotkey");
+    if (*traceDumpHotkey) {
+        HotkeyChord chord;
+        if (ParseHotkey(traceDumpHotkey, chord) && chord.count == 1) {
+            g_settings.traceDumpModifiers = chord.steps[0].modifiers;
+            g_settings.traceDumpVk = chord.steps[0].vk;
+        } else {
+            Wh_Log(L"Invalid trace dump hotkey: %s", traceDumpHotkey);
+        }
+    }
+    Wh_FreeStringSetting(traceDumpHotkey);
+
+    PCWSTR logLevel = Wh_GetStringSetting(L"logLevel");
+    g_logLevel = ParseLogLevel(logLevel);
+    Wh_FreeStringSetting(logLevel);
+}
+
+// Registered on the session event thread, which receives its WM_HOTKEY.
+void RegisterTraceDumpHotkey() {
+    if (g_settings.traceDumpVk &&
+        !RegisterHotKey(nullptr, 1,
+                        g_settings.traceDumpModifiers | MOD_NOREPEAT,
+                        g_settings.traceDumpVk)) {
+        Wh_Log(L"RegisterHotKey failed: %u", GetLastError());
+    }
+}
+
+// Waits for EVENT_SYSTEM_SWITCHEND, which is raised when Alt+Tab is dismissed,
+// or for the switcher window to go away to close the session. Also owns the
+// trace dump hotkey.
+DWORD WINAPI SessionEventThreadProc(LPVOID lpParameter) {
+    MSG msg;
+    PeekMessage(&msg, nullptr, 0, 0, PM_NOREMOVE);
+    SetEvent((HANDLE)lpParameter);
+
+    HWINEVENTHOOK hook = SetWinEventHook(
+        EVENT_SYSTEM_SWITCHEND, EVENT_SYSTEM_SWITCHEND, nullptr,
+        SwitchEndEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+    if (hook) {
+        g_switchEndTracked = true;
+    } else {
+        Wh_Log(L"Couldn't track the end of Alt+Tab, sessions will last %llu ms",
+               kUntrackedSessionDuration);
+    }
+
+    RegisterTraceDumpHotkey();
+
+    while (GetMessage(&msg, nullptr, 0, 0) > 0) {
+        if (!msg.hwnd && msg.message == WM_HOTKEY) {
+            DumpSessionTraces();
+            continue;
+        }
+
+        if (!msg.hwnd && msg.message == WM_APP_RELOAD_SETTINGS) {
+            UnregisterHotKey(nullptr, 1);
+            LoadSettings();
+            RegisterTraceDumpHotkey();
+            continue;
+        }
+
+        if (!msg.hwnd && msg.message == WM_APP_SESSION_CHANGED) {
+            SyncSwitcherHook();
+            continue;
+        }
+
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    UnregisterHotKey(nullptr, 1);
+
+    if (g_switcherHook) {
+        UnhookWinEvent(g_switcherHook);
+        g_switcherHook = nullptr;
+    }
+
+    g_switchEndTracked = false;
+    if (hook) {
+        UnhookWinEvent(hook);
+    }
+    return 0;
+}
+
 using XamlAltTabViewHost_CreateInstance_t = HRESULT(WINAPI*)(void* pThis,
                                                              void* param1,
                                                              void* param2,
@@ -294,13 +1174,9 @@ HRESULT WINAPI XamlAltTabViewHost_CreateInstance_Hook(void* pThis,
                                                       void* param1,
                                                       void* param2,
                                                       void* param3) {
-    g_threadIdForXamlAltTabViewHost_CreateInstance = GetCurrentThreadId();
-    g_lastThreadIdForXamlAltTabViewHost_CreateInstance = GetCurrentThreadId();
-    g_CreateInstance_TickCount = GetTickCount64();
-    HRESULT ret = XamlAltTabViewHost_CreateInstance_Original(pThis, param1,
-                                                             param2, param3);
-    g_threadIdForXamlAltTabViewHost_CreateInstance = 0;
-    return ret;
+    BeginAltTabSession();
+    return XamlAltTabViewHost_CreateInstance_Original(pThis, param1, param2,
+                                                      param3);
 }
 
 using CAltTabViewHost_CreateInstance_t = HRESULT(WINAPI*)(void* pThis,
@@ -328,14 +1204,10 @@ HRESULT WINAPI CAltTabViewHost_CreateInstance_Hook(void* pThis,
                                                    void* param9,
                                                    void* param10,
                                                    void* param11) {
-    g_threadIdForXamlAltTabViewHost_CreateInstance = GetCurrentThreadId();
-    g_lastThreadIdForXamlAltTabViewHost_CreateInstance = GetCurrentThreadId();
-    g_CreateInstance_TickCount = GetTickCount64();
-    HRESULT ret = CAltTabViewHost_CreateInstance_Original(
+    BeginAltTabSession();
+    return CAltTabViewHost_CreateInstance_Original(
         pThis, param1, param2, param3, param4, param5, param6, param7, param8,
         param9, param10, param11);
-    g_threadIdForXamlAltTabViewHost_CreateInstance = 0;
-    return ret;
 }
 
 using CAltTabViewHost_CreateInstance_Win11_t = HRESULT(WINAPI*)(void* pThis,
@@ -362,19 +1234,17 @@ HRESULT WINAPI CAltTabViewHost_CreateInstance_Win11_Hook(void* pThis,
                                                          void* param8,
                                                          void* param9,
                                                          void* param10) {
-    g_threadIdForXamlAltTabViewHost_CreateInstance = GetCurrentThreadId();
-    g_lastThreadIdForXamlAltTabViewHost_CreateInstance = GetCurrentThreadId();
-    g_CreateInstance_TickCount = GetTickCount64();
-    HRESULT ret = CAltTabViewHost_CreateInstance_Win11_Original(
+    BeginAltTabSession();
+    return CAltTabViewHost_CreateInstance_Win11_Original(
         pThis, param1, param2, param3, param4, param5, param6, param7, param8,
         param9, param10);
-    g_threadIdForXamlAltTabViewHost_CreateInstance = 0;
-    return ret;
 }
 
 BOOL Wh_ModInit() {
     Wh_Log(L">");
 
+    LoadSettings();
+
     g_winVersion = GetWindowsVersion();
 
     HMODULE twinuiPcshellModule = LoadLibrary(L"twinui.pcshell.dll");
@@ -500,5 +1370,44 @@ BOOL Wh_ModInit() {
         return FALSE;
     }
 
+    StartLogThread();
+
+    HANDLE readyEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    g_sessionEventThread =
+        CreateThread(nullptr, 0, SessionEventThreadProc, readyEvent, 0,
+                     &g_sessionEventThreadId);
+    if (g_sessionEventThread) {
+        WaitForSingleObject(readyEvent, INFINITE);
+    }
+    CloseHandle(readyEvent);
+
+    return TRUE;
+}
+
+void Wh_ModUninit() {
+    Wh_Log(L">");
+
+    if (g_sessionEventThread) {
+        PostThreadMessage(g_sessionEventThreadId, WM_QUIT, 0, 0);
+        WaitForSingleObject(g_sessionEventThread, INFINITE);
+        CloseHandle(g_sessionEventThread);
+        g_sessionEventThread = nullptr;
+    }
+
+    EndAltTabSession();
+
+    StopLogThread();
+}
+
+BOOL Wh_ModSettingsChanged(BOOL* bReload) {
+    Wh_Log(L">");
+
+    // The hotkey belongs to the session event thread, so it reloads there.
+    if (!g_sessionEventThread ||
+        !PostThreadMessage(g_sessionEventThreadId, WM_APP_RELOAD_SETTINGS, 0,
+                           0)) {
+        *bReload = TRUE;
+    }
+
     return TRUE;
 }
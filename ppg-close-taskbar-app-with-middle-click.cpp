@@ -44,6 +44,15 @@ Only Windows 10 64-bit and Windows 11 are supported.
     forcefully end the running task
 
     Note: This option won't have effect on a group of taskbar items
+- logLevel: info
+  $name: Log level
+  $description: >-
+    How much the mod logs while it runs. Every hook call is only logged by
+    builds compiled with -DLOG_MAX_LEVEL=3.
+  $options:
+  - error: Errors only
+  - info: Actions
+  - trace: Every hook call
 */
 // ==/WindhawkModSettings==
 
@@ -52,6 +61,7 @@ Only Windows 10 64-bit and Windows 11 are supported.
 
 #include <algorithm>
 #include <atomic>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -68,6 +78,158 @@ struct {
     bool keysToEndTaskAlt;
 } g_settings;
 
+// Hot-path logging. LOG_TRACE compiles out unless the mod is built with
+// -DLOG_MAX_LEVEL=3 in @compilerOptions, and the levels that are compiled in
+// are gated at runtime by the logLevel setting. Messages are formatted on the
+// calling thread and written by a logger thread, so a hooked shell thread
+// never waits for Wh_Log. Wh_Log prefixes every line with the logger thread's
+// function, so messages name their origin themselves where it matters.
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_TRACE 3
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_AT(level, message, ...)                                        \
+    do {                                                                   \
+        if ((level) <= g_logLevel.load(std::memory_order_relaxed)) {       \
+            LogWrite(message, ##__VA_ARGS__);                              \
+        }                                                                  \
+    } while (0)
+
+#define LOG_ERROR(message, ...) LOG_AT(LOG_LEVEL_ERROR, message, ##__VA_ARGS__)
+
+#if LOG_MAX_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(message, ...) LOG_AT(LOG_LEVEL_INFO, message, ##__VA_ARGS__)
+#else
+#define LOG_INFO(message, ...) \
+    do {                       \
+    } while (0)
+#endif
+
+#if LOG_MAX_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(message, ...) LOG_AT(LOG_LEVEL_TRACE, message, ##__VA_ARGS__)
+#else
+#define LOG_TRACE(message, ...) \
+    do {                        \
+    } while (0)
+#endif
+
+// Lines beyond this many waiting for the logger thread are dropped.
+constexpr size_t kLogQueueLimit = 1024;
+
+std::atomic<int> g_logLevel{LOG_LEVEL_INFO};
+std::mutex g_logMutex;
+std::vector<std::wstring> g_logQueue;
+size_t g_logDropped;
+// Set under g_logMutex once the logger thread is told to stop. The event is
+// only signalled under the same lock, so no writer can touch it after
+// StopLogThread closes it.
+bool g_logStopped;
+HANDLE g_logEvent;
+HANDLE g_logThread;
+
+void LogWrite(PCWSTR format, ...) {
+    thread_local WCHAR buffer[1024];
+
+    va_list args;
+    va_start(args, format);
+    _vsnwprintf(buffer, ARRAYSIZE(buffer) - 1, format, args);
+    va_end(args);
+    buffer[ARRAYSIZE(buffer) - 1] = L'\0';
+
+    std::lock_guard<std::mutex> guard(g_logMutex);
+    if (g_logStopped || !g_logEvent) {
+        return;
+    }
+
+    if (g_logQueue.size() >= kLogQueueLimit) {
+        g_logDropped++;
+        return;
+    }
+
+    g_logQueue.emplace_back(buffer);
+    SetEvent(g_logEvent);
+}
+
+DWORD WINAPI LogThreadProc(LPVOID lpParameter) {
+    std::vector<std::wstring> lines;
+    while (true) {
+        WaitForSingleObject(g_logEvent, INFINITE);
+
+        bool stopping;
+        size_t dropped;
+        {
+            std::lock_guard<std::mutex> guard(g_logMutex);
+            stopping = g_logStopped;
+            lines.swap(g_logQueue);
+            dropped = g_logDropped;
+            g_logDropped = 0;
+        }
+
+        for (const auto& line : lines) {
+            Wh_Log(L"%s", line.c_str());
+        }
+        lines.clear();
+
+        if (dropped) {
+            Wh_Log(L"Dropped %zu log lines", dropped);
+        }
+
+        if (stopping) {
+            return 0;
+        }
+    }
+}
+
+void StartLogThread() {
+    HANDLE event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    {
+        std::lock_guard<std::mutex> guard(g_logMutex);
+        g_logStopped = false;
+        g_logEvent = event;
+    }
+    g_logThread = CreateThread(nullptr, 0, LogThreadProc, nullptr, 0, nullptr);
+}
+
+// Writes whatever is still queued before returning.
+void StopLogThread() {
+    {
+        std::lock_guard<std::mutex> guard(g_logMutex);
+        g_logStopped = true;
+        if (g_logEvent) {
+            SetEvent(g_logEvent);
+        }
+    }
+
+    if (g_logThread) {
+        WaitForSingleObject(g_logThread, INFINITE);
+        CloseHandle(g_logThread);
+        g_logThread = nullptr;
+    }
+
+    HANDLE event;
+    {
+        std::lock_guard<std::mutex> guard(g_logMutex);
+        event = g_logEvent;
+        g_logEvent = nullptr;
+    }
+    if (event) {
+        CloseHandle(event);
+    }
+}
+
+int ParseLogLevel(PCWSTR logLevel) {
+    if (wcscmp(logLevel, L"error") == 0) {
+        return LOG_LEVEL_ERROR;
+    } else if (wcscmp(logLevel, L"trace") == 0) {
+        return LOG_LEVEL_TRACE;
+    }
+    return LOG_LEVEL_INFO;
+}
+
 enum class WinVersion {
     Unsupported,
     Win10,
@@ -148,7 +310,7 @@ long WINAPI CTaskListWnd_HandleClick_Hook(LPVOID pThis,
                                           LPVOID param1,
                                           LPVOID param2,
                                           LPVOID param3) {
-    Wh_Log(L">");
+    LOG_TRACE(L"> CTaskListWnd::HandleClick");
 
     g_pCTaskListWndHandlingClick = pThis;
 
@@ -165,7 +327,7 @@ void WINAPI CTaskListWnd__HandleClick_Hook(LPVOID pThis,
                                            int clickAction,
                                            int param4,
                                            int param5) {
-    Wh_Log(L"> %d", clickAction);
+    LOG_TRACE(L"> CTaskListWnd::_HandleClick %d", clickAction);
 
     if (!CTaskListWnd_HandleClick_Original) {
         // A magic number for Win10.
@@ -192,7 +354,7 @@ long WINAPI CTaskBand_Launch_Hook(LPVOID pThis,
                                   LPVOID taskGroup,
                                   LPVOID param2,
                                   int param3) {
-    Wh_Log(L">");
+    LOG_TRACE(L"> CTaskBand::Launch");
 
     auto original = [=]() {
         return CTaskBand_Launch_Original(pThis, taskGroup, param2, param3);
@@ -288,13 +450,13 @@ long WINAPI CTaskBand_Launch_Hook(LPVOID pThis,
 
     if (endTask) {
         if (hWnd) {
-            Wh_Log(L"Ending task for HWND %08X", (DWORD)(ULONG_PTR)hWnd);
+            LOG_INFO(L"Ending task for HWND %08X", (DWORD)(ULONG_PTR)hWnd);
             CTaskBand__EndTask_Original(pThis, hWnd, TRUE);
         } else {
-            Wh_Log(L"No HWND to end task");
+            LOG_ERROR(L"No HWND to end task");
         }
     } else {
-        Wh_Log(L"Closing HWND %08X", (DWORD)(ULONG_PTR)hWnd);
+        LOG_INFO(L"Closing HWND %08X", (DWORD)(ULONG_PTR)hWnd);
 
         POINT pt;
         GetCursorPos(&pt);
@@ -827,6 +989,10 @@ void LoadSettings() {
 
     g_settings.keysToEndTaskCtrl = Wh_GetIntSetting(L"keysToEndTask.Ctrl");
     g_settings.keysToEndTaskAlt = Wh_GetIntSetting(L"keysToEndTask.Alt");
+
+    PCWSTR logLevel = Wh_GetStringSetting(L"logLevel");
+    g_logLevel = ParseLogLevel(logLevel);
+    Wh_FreeStringSetting(logLevel);
 }
 
 BOOL Wh_ModInit() {
@@ -846,9 +1012,17 @@ BOOL Wh_ModInit() {
 
     g_initialized = true;
 
+    StartLogThread();
+
     return TRUE;
 }
 
+void Wh_ModUninit() {
+    Wh_Log(L">");
+
+    StopLogThread();
+}
+
 BOOL Wh_ModSettingsChanged(BOOL* bReload) {
     Wh_Log(L">");
 
@@ -1,18 +1,20 @@
 // ==WindhawkMod==
 // @id              ppg-resize-active-window
 // @name            PPG - Resize Active Window
-// @description     Resize the currently selected window to 1440x900 desktop breakpoint
+// @description     Resize the currently selected window through configurable desktop breakpoints, 1440x900 first
 // @version         1
 // @author          Pepe Gazzo
 // @include         explorer.exe
-// @compilerOptions -luser32 -lpsapi
+// @compilerOptions -luser32 -lpsapi -lshcore -ldwmapi
 // ==/WindhawkMod==
 
 // ==WindhawkModReadme==
 /*
 # PPG - Resize Active Window
 
-This mod resizes the currently active window to a fixed size of 1440×900 when a hotkey is pressed.
+This mod resizes the currently active window to a desktop breakpoint, 1440×900 by default, when a hotkey is pressed. Pressing it again on the same window moves on to the next breakpoint in the list. Sizes are scaled for the DPI of the window's monitor.
+
+It can also size new windows automatically: add a rule naming an executable or a window class, and matching windows open at that size, optionally centered on a given monitor.
 
 It's designed for users who want consistent window sizing across workspaces in multi-monitor setups — especially useful for web designers and developers.
 
@@ -25,103 +27,1121 @@ You can customize the hotkey in the mod settings.
 /*
 - Hotkey: Ctrl+Shift+Alt+F5
   $name: "Hotkey combination"
-  $description: "The hotkey combination to resize the active window. Format: Modifiers+Key, e.g. Ctrl+Shift+Alt+F5"
-  $options:
-    - "Ctrl+Shift+Alt+F1": "Ctrl+Shift+Alt+F1"
-    - "Ctrl+Shift+Alt+F2": "Ctrl+Shift+Alt+F2"
-    - "Ctrl+Shift+Alt+F3": "Ctrl+Shift+Alt+F3"
-    - "Ctrl+Shift+Alt+F4": "Ctrl+Shift+Alt+F4"
-    - "Ctrl+Shift+Alt+F5": "Ctrl+Shift+Alt+F5"
-    - "Ctrl+Shift+Alt+F6": "Ctrl+Shift+Alt+F6"
-    - "Ctrl+Shift+Alt+F7": "Ctrl+Shift+Alt+F7"
-    - "Ctrl+Shift+Alt+F8": "Ctrl+Shift+Alt+F8"
-    - "Ctrl+Shift+Alt+F9": "Ctrl+Shift+Alt+F9"
-    - "Ctrl+Shift+Alt+F10": "Ctrl+Shift+Alt+F10"
-    - "Ctrl+Shift+Alt+F11": "Ctrl+Shift+Alt+F11"
-    - "Ctrl+Shift+Alt+F12": "Ctrl+Shift+Alt+F12"
+  $description: "The hotkey combination to resize the active window. Format: Modifiers+Key, e.g. Ctrl+Shift+Alt+F5, or, with chords allowed, a comma-separated chord such as Ctrl+K, Ctrl+M. Keys can be letters, digits, F1-F24, names like Left, Home, PageUp or Num0, punctuation, or 0xNN for any virtual-key code."
+- AllowChords: false
+  $name: Allow chords
+  $description: "Lets hotkeys be comma-separated chords. The first step of every chord, e.g. Ctrl+K, is then taken system-wide, so other applications stop receiving it. Single-step hotkeys work either way."
+- UndoHotkey: ""
+  $name: "Undo hotkey"
+  $description: "Puts back the windows touched by the most recent actions. Same format as the hotkey above; off until set, e.g. Ctrl+Shift+Alt+C."
+- UndoDepth: 1
+  $name: Undo depth
+  $description: How many of the most recent actions one undo press reverts (up to 32)
+- Breakpoints:
+  - 1440x900
+  - 1920x1080
+  - 1280x800
+  $name: Breakpoints
+  $description: Sizes at 100% scaling, written as WIDTHxHEIGHT. The hotkey applies the first one, or the one after the size the window already has.
+- AutoSizeRules:
+  - - Process: ""
+      $name: Process
+      $description: Executable name such as notepad.exe (case-insensitive); empty matches any
+    - WindowClass: ""
+      $name: Window class
+      $description: Window class name (case-insensitive); empty matches any
+    - Width: 1440
+      $name: Width
+    - Height: 900
+      $name: Height
+    - Monitor: 0
+      $name: Monitor
+      $description: Number of the monitor to center the window on; 0 keeps it where it opened
+  $name: Auto-size rules
+  $description: Windows matching a rule are resized when first shown. Sizes are at 100% scaling and follow each monitor's DPI. Leave both the process and the class empty to add no rule.
+- ExcludedProcesses:
+  - ShellExperienceHost.exe
+  - StartMenuExperienceHost.exe
+  - SearchApp.exe
+  - SearchUI.exe
+  - SearchHost.exe
+  - Rainlendar2.exe
+  $name: Excluded processes
+  $description: Executable names whose windows are never touched (case-insensitive)
+- ExcludedWindowClasses: [""]
+  $name: Excluded window classes
+  $description: Window class names that are never touched (case-insensitive)
 */
 // ==/WindhawkModSettings==
 
 #include <windows.h>
+#include <dwmapi.h>
 #include <psapi.h>
+#include <shellscalingapi.h>  // for GetDpiForMonitor
 #include <thread>
 #include <atomic>
+#include <algorithm>
+#include <cwctype>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
-#include <cwctype>
 
 #define HOTKEY_ID  1
+#define WM_APP_RELOAD_SETTINGS  (WM_APP + 1)
+#define WM_APP_PROCESS_EXITED   (WM_APP + 2)
 
 static std::thread       g_hotkeyThread;
 static std::atomic<HWND> g_msgWindow{ nullptr };
 static std::atomic<bool> g_running{ false };
 
-// Custom hotkey storage (filled in Wh_ModInit)
-static UINT g_hotkeyModifiers = MOD_CONTROL | MOD_SHIFT | MOD_ALT;
-static UINT g_hotkeyVk        = VK_F5;
-
-// Split a L"Mod1+Mod2+Key" string into modifiers & virtual-key
-bool ParseHotkey(const std::wstring& hotkeyStr, UINT& modifiers, UINT& vk) {
-    modifiers = 0;
-    vk = 0;
-    std::vector<std::wstring> tokens;
-    size_t start = 0;
-    while (true) {
-        auto pos = hotkeyStr.find(L'+', start);
-        if (pos == std::wstring::npos) {
-            tokens.push_back(hotkeyStr.substr(start));
-            break;
+static constexpr wchar_t kDefaultHotkey[] = L"Ctrl+Shift+Alt+F5";
+
+// — Hotkey grammar —
+//
+// Windhawk builds every mod from a single file, so this section, chord
+// dispatch and the exclusion sets are carried verbatim by each PPG hotkey mod.
+// Change every copy together, so a hotkey string means the same key in all of
+// them.
+//
+// A hotkey is a chord of one or more comma-separated steps, each written as
+// Modifiers+Key, e.g. "Ctrl+Shift+Alt+F5" or "Ctrl+K, Ctrl+M". Key names are
+// looked up in kKeyNames; a single letter or digit names itself and "0xNN"
+// names any virtual-key code directly.
+
+struct KeyName {
+    const wchar_t* name;
+    UINT           vk;
+};
+
+static constexpr KeyName kKeyNames[] = {
+    { L"BACKSPACE", VK_BACK },          { L"BACK", VK_BACK },
+    { L"TAB", VK_TAB },                 { L"CLEAR", VK_CLEAR },
+    { L"ENTER", VK_RETURN },            { L"RETURN", VK_RETURN },
+    { L"PAUSE", VK_PAUSE },             { L"CAPSLOCK", VK_CAPITAL },
+    { L"ESC", VK_ESCAPE },              { L"ESCAPE", VK_ESCAPE },
+    { L"SPACE", VK_SPACE },
+    { L"PAGEUP", VK_PRIOR },            { L"PGUP", VK_PRIOR },
+    { L"PAGEDOWN", VK_NEXT },           { L"PGDN", VK_NEXT },
+    { L"END", VK_END },                 { L"HOME", VK_HOME },
+    { L"LEFT", VK_LEFT },               { L"UP", VK_UP },
+    { L"RIGHT", VK_RIGHT },             { L"DOWN", VK_DOWN },
+    { L"SELECT", VK_SELECT },           { L"PRINT", VK_PRINT },
+    { L"EXECUTE", VK_EXECUTE },
+    { L"PRINTSCREEN", VK_SNAPSHOT },    { L"PRTSC", VK_SNAPSHOT },
+    { L"INSERT", VK_INSERT },           { L"INS", VK_INSERT },
+    { L"DELETE", VK_DELETE },           { L"DEL", VK_DELETE },
+    { L"HELP", VK_HELP },
+    { L"APPS", VK_APPS },               { L"MENU", VK_APPS },
+    { L"SLEEP", VK_SLEEP },
+    { L"NUM0", VK_NUMPAD0 },            { L"NUM1", VK_NUMPAD1 },
+    { L"NUM2", VK_NUMPAD2 },            { L"NUM3", VK_NUMPAD3 },
+    { L"NUM4", VK_NUMPAD4 },            { L"NUM5", VK_NUMPAD5 },
+    { L"NUM6", VK_NUMPAD6 },            { L"NUM7", VK_NUMPAD7 },
+    { L"NUM8", VK_NUMPAD8 },            { L"NUM9", VK_NUMPAD9 },
+    { L"MULTIPLY", VK_MULTIPLY },       { L"ADD", VK_ADD },
+    { L"SEPARATOR", VK_SEPARATOR },     { L"SUBTRACT", VK_SUBTRACT },
+    { L"DECIMAL", VK_DECIMAL },         { L"DIVIDE", VK_DIVIDE },
+    { L"F1", VK_F1 },                   { L"F2", VK_F2 },
+    { L"F3", VK_F3 },                   { L"F4", VK_F4 },
+    { L"F5", VK_F5 },                   { L"F6", VK_F6 },
+    { L"F7", VK_F7 },                   { L"F8", VK_F8 },
+    { L"F9", VK_F9 },                   { L"F10", VK_F10 },
+    { L"F11", VK_F11 },                 { L"F12", VK_F12 },
+    { L"F13", VK_F13 },                 { L"F14", VK_F14 },
+    { L"F15", VK_F15 },                 { L"F16", VK_F16 },
+    { L"F17", VK_F17 },                 { L"F18", VK_F18 },
+    { L"F19", VK_F19 },                 { L"F20", VK_F20 },
+    { L"F21", VK_F21 },                 { L"F22", VK_F22 },
+    { L"F23", VK_F23 },                 { L"F24", VK_F24 },
+    { L"NUMLOCK", VK_NUMLOCK },         { L"SCROLLLOCK", VK_SCROLL },
+    { L"BROWSERBACK", VK_BROWSER_BACK },
+    { L"BROWSERFORWARD", VK_BROWSER_FORWARD },
+    { L"BROWSERREFRESH", VK_BROWSER_REFRESH },
+    { L"BROWSERSTOP", VK_BROWSER_STOP },
+    { L"BROWSERSEARCH", VK_BROWSER_SEARCH },
+    { L"BROWSERFAVORITES", VK_BROWSER_FAVORITES },
+    { L"BROWSERHOME", VK_BROWSER_HOME },
+    { L"VOLUMEMUTE", VK_VOLUME_MUTE },  { L"VOLUMEDOWN", VK_VOLUME_DOWN },
+    { L"VOLUMEUP", VK_VOLUME_UP },
+    { L"MEDIANEXT", VK_MEDIA_NEXT_TRACK },
+    { L"MEDIAPREV", VK_MEDIA_PREV_TRACK },
+    { L"MEDIASTOP", VK_MEDIA_STOP },
+    { L"MEDIAPLAYPAUSE", VK_MEDIA_PLAY_PAUSE },
+    { L"LAUNCHMAIL", VK_LAUNCH_MAIL },
+    { L"LAUNCHMEDIA", VK_LAUNCH_MEDIA_SELECT },
+    { L"LAUNCHAPP1", VK_LAUNCH_APP1 },  { L"LAUNCHAPP2", VK_LAUNCH_APP2 },
+    // OEM keys, named after their US-layout legends. "+" and "," separate
+    // steps, so those two keys are only reachable by name.
+    { L";", VK_OEM_1 },                 { L"SEMICOLON", VK_OEM_1 },
+    { L"=", VK_OEM_PLUS },              { L"PLUS", VK_OEM_PLUS },
+    { L"COMMA", VK_OEM_COMMA },
+    { L"-", VK_OEM_MINUS },             { L"MINUS", VK_OEM_MINUS },
+    { L".", VK_OEM_PERIOD },            { L"PERIOD", VK_OEM_PERIOD },
+    { L"/", VK_OEM_2 },                 { L"SLASH", VK_OEM_2 },
+    { L"`", VK_OEM_3 },                 { L"BACKTICK", VK_OEM_3 },
+    { L"[", VK_OEM_4 },                 { L"LBRACKET", VK_OEM_4 },
+    { L"\\", VK_OEM_5 },                { L"BACKSLASH", VK_OEM_5 },
+    { L"]", VK_OEM_6 },                 { L"RBRACKET", VK_OEM_6 },
+    { L"'", VK_OEM_7 },                 { L"QUOTE", VK_OEM_7 },
+    { L"OEM8", VK_OEM_8 },              { L"OEM102", VK_OEM_102 },
+};
+
+constexpr size_t kMaxChordSteps = 4;
+
+struct HotkeyStep {
+    UINT modifiers;
+    UINT vk;
+};
+
+struct HotkeyChord {
+    HotkeyStep steps[kMaxChordSteps];
+    size_t     count;
+};
+
+static wchar_t AsciiUpper(wchar_t c) {
+    return (c >= L'a' && c <= L'z') ? wchar_t(c - L'a' + L'A') : c;
+}
+
+static bool EqualsNoCase(std::wstring_view a, const wchar_t* b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i) {
+        if (AsciiUpper(a[i]) != AsciiUpper(b[i])) return false;
+    }
+    return i == a.size() && !b[i];
+}
+
+static std::wstring_view TrimSpaces(std::wstring_view s) {
+    while (!s.empty() && s.front() == L' ') s.remove_prefix(1);
+    while (!s.empty() && s.back() == L' ')  s.remove_suffix(1);
+    return s;
+}
+
+static UINT LookupModifier(std::wstring_view tok) {
+    if (EqualsNoCase(tok, L"SHIFT"))                                 return MOD_SHIFT;
+    if (EqualsNoCase(tok, L"CTRL") || EqualsNoCase(tok, L"CONTROL")) return MOD_CONTROL;
+    if (EqualsNoCase(tok, L"ALT"))                                   return MOD_ALT;
+    if (EqualsNoCase(tok, L"WIN") || EqualsNoCase(tok, L"WINDOWS"))  return MOD_WIN;
+    return 0;
+}
+
+static UINT LookupKey(std::wstring_view tok) {
+    if (tok.size() == 1) {
+        wchar_t c = AsciiUpper(tok[0]);
+        if ((c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9')) return c;
+    }
+    if (tok.size() > 2 && tok[0] == L'0' && AsciiUpper(tok[1]) == L'X') {
+        UINT vk = 0;
+        for (size_t i = 2; i < tok.size(); ++i) {
+            wchar_t c = AsciiUpper(tok[i]);
+            if (c >= L'0' && c <= L'9')      vk = vk * 16 + (c - L'0');
+            else if (c >= L'A' && c <= L'F') vk = vk * 16 + (c - L'A' + 10);
+            else return 0;
+            if (vk > 0xFE) return 0;
+        }
+        return vk;
+    }
+    for (const auto& key : kKeyNames) {
+        if (EqualsNoCase(tok, key.name)) return key.vk;
+    }
+    return 0;
+}
+
+// Parse a single Modifiers+Key step. Unknown modifiers or keys fail the
+// whole step instead of being dropped.
+static bool ParseHotkeyStep(std::wstring_view s, HotkeyStep& step) {
+    step = {};
+    for (size_t pos; (pos = s.find(L'+')) != std::wstring_view::npos; s.remove_prefix(pos + 1)) {
+        UINT mod = LookupModifier(TrimSpaces(s.substr(0, pos)));
+        if (!mod) return false;
+        step.modifiers |= mod;
+    }
+    step.vk = LookupKey(TrimSpaces(s));
+    return step.vk != 0;
+}
+
+// Split a L"Mod1+Mod2+Key, Mod1+Key" string into chord steps
+bool ParseHotkey(std::wstring_view s, HotkeyChord& chord) {
+    chord = {};
+    while (chord.count < kMaxChordSteps) {
+        size_t pos = s.find(L',');
+        if (!ParseHotkeyStep(s.substr(0, pos), chord.steps[chord.count])) return false;
+        chord.count++;
+        if (pos == std::wstring_view::npos) return true;
+        s.remove_prefix(pos + 1);
+    }
+    return false;
+}
+
+// — Chord dispatch —
+//
+// Bindings form a trie keyed by packed (modifiers, vk) steps, so every
+// WM_HOTKEY is one hash lookup from the current state. The first step of
+// each binding stays registered; deeper steps are registered only while a
+// chord is in progress and are dropped again when it completes or times out.
+// A registered first step is taken from every other application, so chords
+// are only bound when the AllowChords setting asks for them.
+
+#define CHORD_HOTKEY_ID_BASE  0x100
+#define CHORD_TIMER_ID        1
+
+constexpr UINT kChordTimeoutMs = 1500;
+
+static UINT PackHotkeyStep(UINT modifiers, UINT vk) {
+    return (modifiers & 0xFFFF) << 16 | (vk & 0xFFFF);
+}
+
+class HotkeyDispatcher {
+public:
+    void Clear() {
+        nodes.assign(1, Node{});
+        state = 0;
+    }
+
+    // Fails if the chord is a prefix of, or prefixed by, an existing binding.
+    bool Add(const HotkeyChord& chord, int action) {
+        size_t node = 0;
+        for (size_t i = 0; i < chord.count; ++i) {
+            if (nodes[node].action >= 0) return false;
+            UINT key = PackHotkeyStep(chord.steps[i].modifiers, chord.steps[i].vk);
+            auto it = nodes[node].next.find(key);
+            size_t child;
+            if (it != nodes[node].next.end()) {
+                child = it->second;
+            } else {
+                child = nodes.size();
+                nodes.emplace_back();
+                nodes[node].next.emplace(key, child);
+            }
+            node = child;
+        }
+        if (node == 0 || nodes[node].action >= 0 || !nodes[node].next.empty()) return false;
+        nodes[node].action = action;
+        return true;
+    }
+
+    void Register(HWND hwnd) {
+        int id = HOTKEY_ID;
+        for (const auto& [key, child] : nodes[0].next) {
+            if (!RegisterHotKey(hwnd, id, HIWORD(key), LOWORD(key)))
+                Wh_Log(L"[resize-active-window] failed to register hotkey (mod=0x%X vk=0x%X): %u", HIWORD(key), LOWORD(key), GetLastError());
+            else
+                Wh_Log(L"[resize-active-window] Hotkey registered (mod=0x%X vk=0x%X)", HIWORD(key), LOWORD(key));
+            id++;
+        }
+        rootCount = id - HOTKEY_ID;
+    }
+
+    void Unregister(HWND hwnd) {
+        ResetState(hwnd);
+        for (int i = 0; i < rootCount; ++i) UnregisterHotKey(hwnd, HOTKEY_ID + i);
+        rootCount = 0;
+    }
+
+    // Feed a WM_HOTKEY; returns the completed binding's action, or -1.
+    int OnHotkey(HWND hwnd, LPARAM lParam) {
+        UINT key = PackHotkeyStep(LOWORD(lParam), HIWORD(lParam));
+        auto it = nodes[state].next.find(key);
+        if (it == nodes[state].next.end() && state != 0) {
+            // Not a continuation: abandon the chord and retry as a first step.
+            ResetState(hwnd);
+            it = nodes[0].next.find(key);
+        }
+        if (it == nodes[state].next.end()) return -1;
+        size_t node = it->second;
+        if (nodes[node].action >= 0) {
+            ResetState(hwnd);
+            return nodes[node].action;
+        }
+        EnterState(hwnd, node);
+        return -1;
+    }
+
+    void OnTimeout(HWND hwnd) {
+        ResetState(hwnd);
+    }
+
+private:
+    struct Node {
+        int action = -1;
+        std::unordered_map<UINT, size_t> next;
+    };
+
+    std::vector<Node> nodes = std::vector<Node>(1);
+    size_t state = 0;
+    int rootCount = 0;
+    int pendingCount = 0;
+
+    void EnterState(HWND hwnd, size_t node) {
+        ResetState(hwnd);
+        state = node;
+        for (const auto& [key, child] : nodes[node].next) {
+            // Keys that are also first steps are registered already.
+            if (nodes[0].next.count(key)) continue;
+            RegisterHotKey(hwnd, CHORD_HOTKEY_ID_BASE + pendingCount, HIWORD(key), LOWORD(key));
+            pendingCount++;
+        }
+        SetTimer(hwnd, CHORD_TIMER_ID, kChordTimeoutMs, nullptr);
+    }
+
+    void ResetState(HWND hwnd) {
+        if (state == 0) return;
+        for (int i = 0; i < pendingCount; ++i) UnregisterHotKey(hwnd, CHORD_HOTKEY_ID_BASE + i);
+        pendingCount = 0;
+        KillTimer(hwnd, CHORD_TIMER_ID);
+        state = 0;
+    }
+};
+
+// — Exclusion sets —
+//
+// Excluded executable and window class names come from the settings and are
+// compiled at load into a case-folded perfect hash (hash-and-displace): every
+// name gets its own slot through a per-bucket displacement, so a lookup is one
+// string hash and at most one compare however many names are configured. If
+// no displacement fits, the names are kept sorted and binary-searched instead.
+
+static wchar_t FoldChar(wchar_t c) {
+    if (c < 0x80) return (c >= L'A' && c <= L'Z') ? wchar_t(c - L'A' + L'a') : c;
+    return (wchar_t)towlower(c);
+}
+
+static unsigned long long HashFolded(const wchar_t* s) {
+    unsigned long long h = 14695981039346656037ull;    // FNV-1a
+    for (; *s; ++s) {
+        h ^= FoldChar(*s);
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;                                      // murmur3 finalizer
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+class NameSet {
+public:
+    void Build(const std::vector<std::wstring>& names) {
+        std::vector<std::wstring> folded;
+        for (const auto& name : names) {
+            std::wstring f = name;
+            for (auto& c : f) c = FoldChar(c);
+            if (!f.empty() && std::find(folded.begin(), folded.end(), f) == folded.end())
+                folded.push_back(std::move(f));
+        }
+        slots.clear();
+        displacements.clear();
+        sorted.clear();
+        count = 0;
+        if (folded.empty()) return;
+
+        size_t bucketCount = 1;
+        while (bucketCount < folded.size()) bucketCount <<= 1;
+        for (size_t slotCount = bucketCount * 2; slotCount <= bucketCount * 64; slotCount <<= 1) {
+            if (TryBuild(folded, bucketCount, slotCount)) return;
+        }
+        Wh_Log(L"[resize-active-window] no perfect hash for %zu names, falling back to a sorted list", folded.size());
+        slots.clear();
+        displacements.clear();
+        std::sort(folded.begin(), folded.end());
+        sorted = std::move(folded);
+        count = sorted.size();
+    }
+
+    bool Empty() const { return count == 0; }
+    size_t Size() const { return count; }
+
+    bool Contains(const wchar_t* name) const {
+        if (!sorted.empty()) {
+            std::wstring folded = name;
+            for (auto& c : folded) c = FoldChar(c);
+            return std::binary_search(sorted.begin(), sorted.end(), folded);
+        }
+        if (slots.empty()) return false;
+        unsigned long long h = HashFolded(name);
+        UINT d = displacements[h & (displacements.size() - 1)];
+        const std::wstring& slot = slots[Slot(h, d, slots.size())];
+        size_t i = 0;
+        for (; name[i] && i < slot.size(); ++i) {
+            if (FoldChar(name[i]) != slot[i]) return false;
+        }
+        return !name[i] && i == slot.size();
+    }
+
+private:
+    std::vector<std::wstring> slots;      // folded names, empty = free
+    std::vector<UINT> displacements;      // one per bucket
+    std::vector<std::wstring> sorted;     // folded names, when no hash fits
+    size_t count = 0;
+
+    // h2 is odd and the slot count a power of two, so d walks every slot.
+    static size_t Slot(unsigned long long h, UINT d, size_t slotCount) {
+        UINT h1 = (UINT)(h >> 32);
+        UINT h2 = (UINT)(h >> 8) | 1;
+        return (h1 + d * h2) & (slotCount - 1);
+    }
+
+    bool TryBuild(const std::vector<std::wstring>& names, size_t bucketCount, size_t slotCount) {
+        std::vector<std::vector<unsigned long long>> buckets(bucketCount);
+        for (const auto& name : names) {
+            unsigned long long h = HashFolded(name.c_str());
+            buckets[h & (bucketCount - 1)].push_back(h);
+        }
+        std::vector<size_t> order(bucketCount);
+        for (size_t i = 0; i < bucketCount; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        // Place the largest buckets first, trying displacements until all of
+        // a bucket's names land in distinct free slots.
+        std::vector<bool> used(slotCount);
+        displacements.assign(bucketCount, 0);
+        for (size_t b : order) {
+            const auto& bucket = buckets[b];
+            if (bucket.empty()) break;
+            bool placed = false;
+            for (UINT d = 0; d < slotCount && !placed; ++d) {
+                std::vector<size_t> taken;
+                for (auto h : bucket) {
+                    size_t s = Slot(h, d, slotCount);
+                    if (used[s] || std::find(taken.begin(), taken.end(), s) != taken.end()) break;
+                    taken.push_back(s);
+                }
+                if (taken.size() != bucket.size()) continue;
+                for (size_t s : taken) used[s] = true;
+                displacements[b] = d;
+                placed = true;
+            }
+            if (!placed) return false;
+        }
+
+        slots.assign(slotCount, std::wstring());
+        for (const auto& name : names) {
+            unsigned long long h = HashFolded(name.c_str());
+            slots[Slot(h, displacements[h & (bucketCount - 1)], slotCount)] = name;
+        }
+        count = names.size();
+        return true;
+    }
+};
+
+static NameSet g_excludedProcesses;
+static NameSet g_excludedClasses;
+
+// Read a string-array setting such as L"ExcludedProcesses"; the list ends at
+// the first empty entry.
+static std::vector<std::wstring> LoadStringList(PCWSTR name) {
+    std::vector<std::wstring> items;
+    for (int i = 0;; ++i) {
+        PCWSTR value = Wh_GetStringSetting(L"%s[%d]", name, i);
+        bool end = !value || !*value;
+        if (!end) items.push_back(value);
+        if (value) Wh_FreeStringSetting(value);
+        if (end) break;
+    }
+    return items;
+}
+
+// — Window filter —
+//
+// Which windows an action takes is described once as a FilterSpec and
+// compiled into a WindowFilter: a list of stages ordered from cheapest to
+// most expensive, leaving out stages the spec doesn't use. Style and owner
+// tests read values already in hand, cloaking is one DWM call, the class set
+// needs GetClassName, and the executable set needs a process query, so a
+// window is rejected by the cheapest test that can reject it. Rejections are
+// counted per stage.
+
+enum FilterStage {
+    STAGE_STYLE,
+    STAGE_EXSTYLE,
+    STAGE_OWNER,
+    STAGE_CLOAK,
+    STAGE_CLASS,
+    STAGE_PROCESS,
+    STAGE_COUNT,
+};
+
+static constexpr const wchar_t* kStageNames[STAGE_COUNT] = {
+    L"style", L"exstyle", L"owner", L"cloak", L"class", L"process",
+};
+
+// Whether the process's executable is in `processes`; unqueryable processes
+// aren't excluded.
+static bool IsProcessExcluded(DWORD pid, const NameSet& processes) {
+    if (!pid) return false;
+    HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!hProc) return false;
+    bool excluded = false;
+    wchar_t fullPath[MAX_PATH] = {};
+    DWORD size = _countof(fullPath);
+    if (QueryFullProcessImageName(hProc, 0, fullPath, &size)) {
+        const wchar_t* exe = wcsrchr(fullPath, L'\\');
+        excluded = processes.Contains(exe ? exe + 1 : fullPath);
+    }
+    CloseHandle(hProc);
+    return excluded;
+}
+
+struct FilterSpec {
+    DWORD styleMask = 0, styleValue = 0;        // (style & mask) == value
+    DWORD exStyleMask = 0, exStyleValue = 0;
+    bool  unowned = false;
+    bool  uncloaked = false;
+    const NameSet* excludedClasses = nullptr;
+    const NameSet* excludedProcesses = nullptr;
+};
+
+// https://devblogs.microsoft.com/oldnewthing/20200302-00/?p=103507
+static bool IsWindowCloaked(HWND hwnd) {
+    BOOL isCloaked = FALSE;
+    return SUCCEEDED(DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &isCloaked, sizeof(isCloaked))) && isCloaked;
+}
+
+class WindowFilter {
+public:
+    UINT passed = 0;
+    UINT rejected[STAGE_COUNT] = {};
+
+    void Compile(const FilterSpec& filterSpec) {
+        spec = filterSpec;
+        stageCount = 0;
+        if (spec.styleMask)   stages[stageCount++] = STAGE_STYLE;
+        if (spec.exStyleMask) stages[stageCount++] = STAGE_EXSTYLE;
+        if (spec.unowned)     stages[stageCount++] = STAGE_OWNER;
+        if (spec.uncloaked)   stages[stageCount++] = STAGE_CLOAK;
+        if (spec.excludedClasses && !spec.excludedClasses->Empty())     stages[stageCount++] = STAGE_CLASS;
+        if (spec.excludedProcesses && !spec.excludedProcesses->Empty()) stages[stageCount++] = STAGE_PROCESS;
+        ResetCounts();
+    }
+
+    void ResetCounts() {
+        passed = 0;
+        for (auto& count : rejected) count = 0;
+    }
+
+    bool Accept(HWND hwnd, HWND owner, DWORD pid, DWORD style, DWORD exStyle) {
+        for (size_t i = 0; i < stageCount; ++i) {
+            if (!Test(stages[i], hwnd, owner, pid, style, exStyle)) {
+                rejected[stages[i]]++;
+                return false;
+            }
+        }
+        passed++;
+        return true;
+    }
+
+    // e.g. "12 passed; rejected: style 80, owner 31, process 6"
+    std::wstring Report() const {
+        std::wstring report = std::to_wstring(passed) + L" passed; rejected:";
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            if (rejected[s]) report += L" " + std::wstring(kStageNames[s]) + L" " + std::to_wstring(rejected[s]);
+        }
+        return report;
+    }
+
+private:
+    FilterSpec  spec;
+    FilterStage stages[STAGE_COUNT];
+    size_t      stageCount = 0;
+
+    bool Test(FilterStage stage, HWND hwnd, HWND owner, DWORD pid, DWORD style, DWORD exStyle) const {
+        switch (stage) {
+            case STAGE_STYLE:   return (style & spec.styleMask) == spec.styleValue;
+            case STAGE_EXSTYLE: return (exStyle & spec.exStyleMask) == spec.exStyleValue;
+            case STAGE_OWNER:   return !owner;
+            case STAGE_CLOAK:   return !IsWindowCloaked(hwnd);
+            case STAGE_CLASS: {
+                wchar_t className[256];
+                return !GetClassName(hwnd, className, _countof(className)) ||
+                       !spec.excludedClasses->Contains(className);
+            }
+            case STAGE_PROCESS: return !IsProcessExcluded(pid, *spec.excludedProcesses);
+            default:            return true;
+        }
+    }
+};
+
+static WindowFilter g_activeFilter;
+
+// — Breakpoints —
+//
+// The sizes the hotkey cycles through, written as WIDTHxHEIGHT at 100%
+// scaling and scaled by the DPI of each window's monitor.
+
+static std::vector<SIZE> g_breakpoints;
+
+static bool ParseDimension(std::wstring_view s, LONG& value) {
+    s = TrimSpaces(s);
+    if (s.empty() || s.size() > 5) return false;
+    value = 0;
+    for (wchar_t c : s) {
+        if (c < L'0' || c > L'9') return false;
+        value = value * 10 + (c - L'0');
+    }
+    return value > 0;
+}
+
+static bool ParseBreakpoint(std::wstring_view s, SIZE& size) {
+    size_t x = s.find_first_of(L"xX×*");
+    return x != std::wstring_view::npos &&
+           ParseDimension(s.substr(0, x), size.cx) && ParseDimension(s.substr(x + 1), size.cy);
+}
+
+static void LoadBreakpoints(SIZE fallback) {
+    g_breakpoints.clear();
+    for (const auto& item : LoadStringList(L"Breakpoints")) {
+        SIZE size;
+        if (ParseBreakpoint(item, size)) g_breakpoints.push_back(size);
+        else Wh_Log(L"[resize-active-window] ignoring breakpoint '%s'", item.c_str());
+    }
+    if (g_breakpoints.empty()) g_breakpoints.push_back(fallback);
+}
+
+// Scales a breakpoint to a monitor's DPI, capped at its work area.
+static SIZE ScaleBreakpoint(SIZE size, UINT dpi, const RECT& work) {
+    size.cx = std::min<LONG>(MulDiv(size.cx, dpi, USER_DEFAULT_SCREEN_DPI), work.right - work.left);
+    size.cy = std::min<LONG>(MulDiv(size.cy, dpi, USER_DEFAULT_SCREEN_DPI), work.bottom - work.top);
+    return size;
+}
+
+// — Auto-size rules —
+//
+// Rules size new windows as they are first shown, picked up through a
+// WinEvent hook on the hotkey thread. A rule matches by window class, by
+// executable, or both. Class rules are checked first since the class name
+// needs no process query; several rules may share a class and differ in
+// executable (Chrome_WidgetWin_1 for chrome.exe and code.exe, say), and the
+// first one whose executable matches wins. Executable rules need the window's
+// image name, so the rule each process resolved to is cached per PID along
+// with a SYNCHRONIZE handle that keeps the PID from being recycled; a process
+// is queried once, not once per window. A thread pool wait on the handle posts
+// WM_APP_PROCESS_EXITED when the process exits, and its entry is dropped then.
+// A process is only opened when an executable rule exists and the window's
+// class hasn't already decided the match.
+
+struct AutoSizeRule {
+    std::wstring process;     // folded; empty = any
+    std::wstring className;   // folded; empty = any
+    LONG width, height;       // at 96 DPI
+    int  monitor;             // 1-based; 0 = the monitor the window opened on
+};
+
+static bool FoldedEquals(const wchar_t* name, const std::wstring& folded) {
+    size_t i = 0;
+    for (; name[i] && i < folded.size(); ++i) {
+        if (FoldChar(name[i]) != folded[i]) return false;
+    }
+    return !name[i] && i == folded.size();
+}
+
+class AutoSizeRules {
+public:
+    void Build(std::vector<AutoSizeRule> list) {
+        Clear();
+        rules = std::move(list);
+        for (size_t i = 0; i < rules.size(); ++i) {
+            const AutoSizeRule& rule = rules[i];
+            if (!rule.className.empty()) {
+                auto& candidates = byClass[HashFolded(rule.className.c_str())];
+                auto same = std::find_if(candidates.begin(), candidates.end(), [&](size_t j) {
+                    return rules[j].className == rule.className && rules[j].process == rule.process;
+                });
+                if (same == candidates.end()) candidates.push_back(i);
+                else Wh_Log(L"[resize-active-window] auto-size rule %zu repeats rule %zu and is ignored", i + 1, *same + 1);
+            } else if (!byProcess.emplace(HashFolded(rule.process.c_str()), i).second) {
+                Wh_Log(L"[resize-active-window] auto-size rule %zu repeats an earlier rule for %s and is ignored",
+                       i + 1, rule.process.c_str());
+            }
+        }
+    }
+
+    void Clear() {
+        for (auto& [pid, entry] : processes) Release(entry);
+        processes.clear();
+        byClass.clear();
+        byProcess.clear();
+        rules.clear();
+    }
+
+    bool Empty() const { return rules.empty(); }
+    size_t Size() const { return rules.size(); }
+
+    // Handles WM_APP_PROCESS_EXITED for `pid`.
+    void OnProcessExited(DWORD pid) {
+        auto it = processes.find(pid);
+        if (it == processes.end() || WaitForSingleObject(it->second.process, 0) == WAIT_TIMEOUT) return;
+        Release(it->second);
+        processes.erase(it);
+    }
+
+    // Returns the rule for a window, or nullptr. The process is only queried
+    // when a matching class rule also names an exe, or for the first window
+    // of a process while exe-only rules exist.
+    const AutoSizeRule* Match(const wchar_t* className, DWORD pid) {
+        const ProcessEntry* entry = nullptr;
+        bool queried = false;
+        auto it = byClass.find(HashFolded(className));
+        if (it != byClass.end()) {
+            for (size_t i : it->second) {
+                const AutoSizeRule& rule = rules[i];
+                if (!FoldedEquals(className, rule.className)) continue;
+                if (rule.process.empty()) return &rule;
+                if (!queried) {
+                    entry = pid ? LookupProcess(pid) : nullptr;
+                    queried = true;
+                }
+                if (entry && entry->exeHash == HashFolded(rule.process.c_str())) return &rule;
+            }
+        }
+        if (byProcess.empty() || !pid) return nullptr;
+        if (!queried) entry = LookupProcess(pid);
+        return entry && entry->rule >= 0 ? &rules[entry->rule] : nullptr;
+    }
+
+private:
+    struct ProcessEntry {
+        HANDLE process;
+        HANDLE exitWait;
+        unsigned long long exeHash;
+        int rule;                       // exe-only rule, or -1
+    };
+
+    std::vector<AutoSizeRule> rules;
+    std::unordered_map<unsigned long long, std::vector<size_t>> byClass;
+    std::unordered_map<unsigned long long, size_t> byProcess;
+    std::unordered_map<DWORD, ProcessEntry> processes;
+    ProcessEntry uncachedEntry = {};
+
+    static void CALLBACK OnProcessExit(PVOID context, BOOLEAN) {
+        if (HWND hwnd = g_msgWindow) PostMessage(hwnd, WM_APP_PROCESS_EXITED, (WPARAM)context, 0);
+    }
+
+    static void Release(ProcessEntry& entry) {
+        // Blocks until a callback already under way returns, so none runs
+        // after the mod unloads.
+        UnregisterWaitEx(entry.exitWait, INVALID_HANDLE_VALUE);
+        CloseHandle(entry.process);
+    }
+
+    const ProcessEntry* LookupProcess(DWORD pid) {
+        auto it = processes.find(pid);
+        if (it != processes.end()) {
+            if (WaitForSingleObject(it->second.process, 0) == WAIT_TIMEOUT) return &it->second;
+            // Exited, and the message saying so hasn't arrived yet.
+            Release(it->second);
+            processes.erase(it);
+        }
+
+        HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, pid);
+        if (!hProc) return nullptr;
+        wchar_t fullPath[MAX_PATH] = {};
+        DWORD size = _countof(fullPath);
+        if (!QueryFullProcessImageName(hProc, 0, fullPath, &size)) {
+            CloseHandle(hProc);
+            return nullptr;
+        }
+        const wchar_t* exe = wcsrchr(fullPath, L'\\');
+        exe = exe ? exe + 1 : fullPath;
+
+        ProcessEntry entry = { hProc, nullptr, HashFolded(exe), -1 };
+        auto rule = byProcess.find(entry.exeHash);
+        if (rule != byProcess.end() && FoldedEquals(exe, rules[rule->second].process))
+            entry.rule = (int)rule->second;
+
+        // Without an exit wait nothing would drop the entry, so it is handed
+        // out uncached.
+        if (!RegisterWaitForSingleObject(&entry.exitWait, hProc, OnProcessExit, (PVOID)(UINT_PTR)pid,
+                                         INFINITE, WT_EXECUTEONLYONCE)) {
+            CloseHandle(hProc);
+            uncachedEntry = { nullptr, nullptr, entry.exeHash, entry.rule };
+            return &uncachedEntry;
         }
-        tokens.push_back(hotkeyStr.substr(start, pos - start));
-        start = pos + 1;
-    }
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        std::wstring tok = tokens[i];
-        for (auto& c : tok) c = towupper(c);
-        if (i + 1 < tokens.size()) {
-            if (tok == L"SHIFT")    modifiers |= MOD_SHIFT;
-            else if (tok == L"CTRL" || tok == L"CONTROL") modifiers |= MOD_CONTROL;
-            else if (tok == L"ALT")  modifiers |= MOD_ALT;
-            else if (tok == L"WIN" || tok == L"WINDOWS") modifiers |= MOD_WIN;
-        } else {
-            if (tok.size() == 1) {
-                vk = (UINT)tok[0];
-            } else if (tok[0] == L'F' && tok.size() > 1) {
-                int fn = _wtoi(tok.substr(1).c_str());
-                if (fn >= 1 && fn <= 24) vk = VK_F1 + fn - 1;
-            } else if (tok == L"LEFT")   vk = VK_LEFT;
-            else if (tok == L"RIGHT")    vk = VK_RIGHT;
-            else if (tok == L"UP")       vk = VK_UP;
-            else if (tok == L"DOWN")     vk = VK_DOWN;
-            else if (tok == L"TAB")      vk = VK_TAB;
-            else if (tok == L"ESC" || tok == L"ESCAPE") vk = VK_ESCAPE;
-            else if (tok == L"SPACE")    vk = VK_SPACE;
-        }
-    }
-    return vk != 0;
+        return &processes.emplace(pid, entry).first->second;
+    }
+};
+
+// Only touched from the hotkey thread. g_autoSized holds the windows that
+// have had their first show. Rather than hooking destroy events to trim it,
+// handles of windows that no longer exist are swept out whenever the set has
+// doubled since the last sweep.
+static AutoSizeRules            g_autoSizeRules;
+static std::unordered_set<HWND> g_autoSized;
+
+constexpr size_t kAutoSizedSweepMin = 256;
+static size_t    g_autoSizedSweepAt = kAutoSizedSweepMin;
+
+static void SweepAutoSized() {
+    if (g_autoSized.size() < g_autoSizedSweepAt) return;
+    for (auto it = g_autoSized.begin(); it != g_autoSized.end();) {
+        if (IsWindow(*it)) ++it;
+        else it = g_autoSized.erase(it);
+    }
+    g_autoSizedSweepAt = std::max(kAutoSizedSweepMin, g_autoSized.size() * 2);
+}
+
+static std::vector<AutoSizeRule> LoadAutoSizeRules() {
+    std::vector<AutoSizeRule> rules;
+    for (int i = 0;; ++i) {
+        PCWSTR process = Wh_GetStringSetting(L"AutoSizeRules[%d].Process", i);
+        PCWSTR className = Wh_GetStringSetting(L"AutoSizeRules[%d].WindowClass", i);
+        bool end = (!process || !*process) && (!className || !*className);
+        if (!end) {
+            AutoSizeRule rule = { process ? process : L"", className ? className : L"" };
+            for (auto& c : rule.process) c = FoldChar(c);
+            for (auto& c : rule.className) c = FoldChar(c);
+            rule.width   = std::max(1, Wh_GetIntSetting(L"AutoSizeRules[%d].Width", i));
+            rule.height  = std::max(1, Wh_GetIntSetting(L"AutoSizeRules[%d].Height", i));
+            rule.monitor = std::max(0, Wh_GetIntSetting(L"AutoSizeRules[%d].Monitor", i));
+            rules.push_back(std::move(rule));
+        }
+        if (process) Wh_FreeStringSetting(process);
+        if (className) Wh_FreeStringSetting(className);
+        if (end) break;
+    }
+    return rules;
+}
+
+// — Undo journal —
+//
+// Every action records the pre-action placement of the windows it touches so
+// the undo hotkey can put them back. Records live in a fixed-size byte ring;
+// the oldest actions are evicted when it fills up, so memory stays bounded
+// however many windows are open. Each window is stored as varints: the rect
+// the action gave it, its previous frame rect as a delta from that, and its
+// normal (restored) rect as a delta from the frame rect. Most deltas are zero
+// or only move one edge pair, so a typical entry is a dozen bytes.
+
+constexpr size_t kJournalBytes      = 64 * 1024;
+constexpr size_t kMaxJournalActions = 32;
+
+struct JournalEntry {
+    HWND hwnd;
+    UINT showCmd;
+    RECT normal;        // WINDOWPLACEMENT::rcNormalPosition
+    RECT before;        // frame rect before the action
+    RECT after;         // rect the action applied
+};
+
+class GeometryJournal {
+public:
+    void Record(const std::vector<JournalEntry>& entries) {
+        std::vector<BYTE> bytes;
+        size_t count = 0;
+        for (const auto& e : entries) {
+            size_t mark = bytes.size();
+            PutVarint(bytes, (ULONG_PTR)e.hwnd);
+            PutVarint(bytes, e.showCmd);
+            PutRect(bytes, e.after, {});
+            PutRect(bytes, e.before, e.after);
+            PutRect(bytes, e.normal, e.before);
+            if (bytes.size() > kJournalBytes) {
+                bytes.resize(mark);
+                break;
+            }
+            count++;
+        }
+        if (!count) return;
+
+        while (actionCount && (actionCount == kMaxJournalActions || used + bytes.size() > kJournalBytes))
+            DropOldest();
+
+        Action& action = actions[(first + actionCount) % kMaxJournalActions];
+        action = { head, bytes.size(), count };
+        for (size_t i = 0; i < bytes.size(); ++i) ring[(head + i) % kJournalBytes] = bytes[i];
+        head = (head + bytes.size()) % kJournalBytes;
+        used += bytes.size();
+        actionCount++;
+    }
+
+    // Removes up to `depth` of the newest actions and returns the state
+    // before the oldest of them, one entry per window.
+    std::vector<JournalEntry> Pop(size_t depth, size_t& popped) {
+        std::vector<JournalEntry> result;
+        std::unordered_map<HWND, size_t> index;
+        for (popped = 0; popped < depth && actionCount; ++popped) {
+            const Action& action = actions[(first + actionCount - 1) % kMaxJournalActions];
+            std::vector<BYTE> bytes(action.size);
+            for (size_t i = 0; i < action.size; ++i) bytes[i] = ring[(action.offset + i) % kJournalBytes];
+
+            const BYTE* p = bytes.data();
+            const BYTE* end = p + bytes.size();
+            for (size_t i = 0; i < action.count; ++i) {
+                JournalEntry e;
+                unsigned long long hwnd, showCmd;
+                if (!GetVarint(p, end, hwnd) || !GetVarint(p, end, showCmd) ||
+                    !GetRect(p, end, e.after, {}) || !GetRect(p, end, e.before, e.after) ||
+                    !GetRect(p, end, e.normal, e.before)) {
+                    break;
+                }
+                e.hwnd = (HWND)(ULONG_PTR)hwnd;
+                e.showCmd = (UINT)showCmd;
+                // Older actions overwrite newer ones: undo restores the state
+                // from before the earliest reverted action.
+                auto [it, inserted] = index.emplace(e.hwnd, result.size());
+                if (inserted) result.push_back(e);
+                else          result[it->second] = e;
+            }
+
+            head = action.offset;
+            used -= action.size;
+            actionCount--;
+        }
+        return result;
+    }
+
+    size_t Actions() const { return actionCount; }
+    size_t BytesUsed() const { return used; }
+
+private:
+    struct Action {
+        size_t offset, size, count;
+    };
+
+    BYTE   ring[kJournalBytes];
+    Action actions[kMaxJournalActions];
+    size_t first = 0, actionCount = 0;
+    size_t head = 0, used = 0;
+
+    void DropOldest() {
+        used -= actions[first].size;
+        first = (first + 1) % kMaxJournalActions;
+        actionCount--;
+    }
+
+    static void PutVarint(std::vector<BYTE>& out, unsigned long long v) {
+        for (; v >= 0x80; v >>= 7) out.push_back(BYTE(v | 0x80));
+        out.push_back(BYTE(v));
+    }
+
+    static bool GetVarint(const BYTE*& p, const BYTE* end, unsigned long long& v) {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            BYTE b = *p++;
+            v |= (unsigned long long)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Zigzag-encoded so small negative deltas stay short.
+    static void PutRect(std::vector<BYTE>& out, const RECT& r, const RECT& base) {
+        for (LONG d : { r.left - base.left, r.top - base.top, r.right - base.right, r.bottom - base.bottom }) {
+            int v = (int)d;
+            PutVarint(out, ((unsigned)v << 1) ^ (unsigned)(v >> 31));
+        }
+    }
+
+    static bool GetRect(const BYTE*& p, const BYTE* end, RECT& r, const RECT& base) {
+        LONG d[4];
+        for (auto& value : d) {
+            unsigned long long zz;
+            if (!GetVarint(p, end, zz)) return false;
+            value = (LONG)((int)(zz >> 1) ^ -(int)(zz & 1));
+        }
+        r = { base.left + d[0], base.top + d[1], base.right + d[2], base.bottom + d[3] };
+        return true;
+    }
+};
+
+// Only touched from the hotkey thread.
+static GeometryJournal g_journal;
+static size_t          g_undoDepth = 1;
+
+// Builds a journal entry from the window's current placement.
+static bool CaptureJournalEntry(HWND hwnd, const RECT& after, JournalEntry& e) {
+    WINDOWPLACEMENT wp = { sizeof(wp) };
+    if (!GetWindowPlacement(hwnd, &wp) || !GetWindowRect(hwnd, &e.before)) return false;
+    e.hwnd = hwnd;
+    e.showCmd = wp.showCmd;
+    e.normal = wp.rcNormalPosition;
+    e.after = after;
+    return true;
+}
+
+// Maximized and minimized windows go back through SetWindowPlacement, which
+// can't be deferred; returns false for entries left to the batched path.
+static bool RestorePlacement(const JournalEntry& e) {
+    if (e.showCmd != SW_SHOWMAXIMIZED && e.showCmd != SW_SHOWMINIMIZED) return false;
+    WINDOWPLACEMENT wp = { sizeof(wp) };
+    GetWindowPlacement(e.hwnd, &wp);
+    wp.flags = WPF_ASYNCWINDOWPLACEMENT;
+    wp.showCmd = e.showCmd == SW_SHOWMINIMIZED ? SW_SHOWMINNOACTIVE : e.showCmd;
+    wp.rcNormalPosition = e.normal;
+    SetWindowPlacement(e.hwnd, &wp);
+    return true;
+}
+
+enum {
+    ACTION_RESIZE_ACTIVE,
+    ACTION_UNDO,
+};
+
+static HotkeyDispatcher g_dispatcher;
+static bool             g_allowChords;
+
+// Binds the chord from a hotkey setting. An empty setting leaves the action
+// unbound; an unparsable one falls back to `fallback` when one is given.
+static void BindHotkeySetting(PCWSTR name, PCWSTR fallback, int action) {
+    HotkeyChord chord;
+    bool bound = false;
+    PCWSTR setting = Wh_GetStringSetting(name);
+    if (setting && *setting && ParseHotkey(setting, chord)) {
+        Wh_Log(L"[resize-active-window] using %s: %s", name, setting);
+        bound = true;
+    } else if (fallback) {
+        Wh_Log(L"[resize-active-window] failed to parse %s '%s', using default %s", name, setting ? setting : L"", fallback);
+        bound = ParseHotkey(fallback, chord);
+    } else if (setting && *setting) {
+        Wh_Log(L"[resize-active-window] failed to parse %s '%s', leaving it unbound", name, setting);
+    }
+    if (bound && chord.count > 1 && !g_allowChords) {
+        Wh_Log(L"[resize-active-window] %s is a chord, leaving it unbound until chords are allowed", name);
+        bound = false;
+    }
+    if (setting) Wh_FreeStringSetting(setting);
+    if (bound && !g_dispatcher.Add(chord, action))
+        Wh_Log(L"[resize-active-window] %s conflicts with another hotkey", name);
 }
 
 void ResizeActiveWindow();
+void UndoLastActions();
+void CALLBACK AutoSizeEventProc(HWINEVENTHOOK, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD, DWORD);
 void HotkeyThreadProc();
 
 // — Windhawk entry/exit —
 
+// Reads every setting into the globals. Runs in Wh_ModInit before the hotkey
+// thread starts and afterwards only on that thread, so nothing it touches
+// needs a lock.
+void LoadSettings() {
+    g_dispatcher.Clear();
+    g_allowChords = Wh_GetIntSetting(L"AllowChords") != 0;
+    BindHotkeySetting(L"Hotkey", kDefaultHotkey, ACTION_RESIZE_ACTIVE);
+    BindHotkeySetting(L"UndoHotkey", nullptr, ACTION_UNDO);
+    g_undoDepth = (size_t)std::clamp(Wh_GetIntSetting(L"UndoDepth"), 1, (int)kMaxJournalActions);
+    g_excludedProcesses.Build(LoadStringList(L"ExcludedProcesses"));
+    g_excludedClasses.Build(LoadStringList(L"ExcludedWindowClasses"));
+    FilterSpec spec;
+    spec.styleMask = WS_VISIBLE | WS_MINIMIZE;
+    spec.styleValue = WS_VISIBLE;
+    spec.unowned = spec.uncloaked = true;
+    spec.excludedClasses = &g_excludedClasses;
+    spec.excludedProcesses = &g_excludedProcesses;
+    g_activeFilter.Compile(spec);
+    Wh_Log(L"[resize-active-window] excluding %zu processes, %zu window classes",
+           g_excludedProcesses.Size(), g_excludedClasses.Size());
+    LoadBreakpoints({ 1440, 900 });
+    g_autoSizeRules.Build(LoadAutoSizeRules());
+    Wh_Log(L"[resize-active-window] %zu auto-size rules", g_autoSizeRules.Size());
+}
+
 BOOL Wh_ModInit() {
     Wh_Log(L"[resize-active-window] initializing...");
-    // Load user-configured hotkey
-    PCWSTR setting = Wh_GetStringSetting(L"Hotkey");
-    if (setting) {
-        std::wstring s = setting;
-        Wh_FreeStringSetting(setting);
-        UINT mods = 0, vk = 0;
-        if (ParseHotkey(s, mods, vk)) {
-            g_hotkeyModifiers = mods;
-            g_hotkeyVk        = vk;
-            Wh_Log(L"[resize-active-window] using hotkey: %s", s.c_str());
-        } else {
-            Wh_Log(L"[resize-active-window] failed to parse '%s', using default Ctrl+Shift+Alt+F5", s.c_str());
-        }
-    }
+    LoadSettings();
     g_running = true;
     g_hotkeyThread = std::thread(HotkeyThreadProc);
     return TRUE;
@@ -136,13 +1156,42 @@ void Wh_ModUninit() {
     Wh_Log(L"[resize-active-window] shutdown complete");
 }
 
+// Settings are applied in place by the hotkey thread, so the hotkeys stay
+// live; a full reload is only needed if its window doesn't exist yet.
 BOOL Wh_ModSettingsChanged(BOOL* bReload) {
-    *bReload = TRUE;
+    HWND hwnd = g_msgWindow.load();
+    *bReload = !hwnd || !PostMessage(hwnd, WM_APP_RELOAD_SETTINGS, 0, 0);
     return TRUE;
 }
 
 // — Hotkey thread: message-only window + hotkey + loop —
 
+// The event hook is only installed while there are rules to apply. It is out
+// of context and global, so every object shown anywhere is marshalled to this
+// thread; it takes show events alone to keep that traffic down.
+void SyncAutoSizeHook(HWINEVENTHOOK& hook) {
+    if (g_autoSizeRules.Empty() && hook) {
+        UnhookWinEvent(hook);
+        hook = nullptr;
+        g_autoSized.clear();
+        g_autoSizedSweepAt = kAutoSizedSweepMin;
+    } else if (!g_autoSizeRules.Empty() && !hook) {
+        hook = SetWinEventHook(EVENT_OBJECT_SHOW, EVENT_OBJECT_SHOW, nullptr,
+                               AutoSizeEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+        if (!hook) {
+            Wh_Log(L"[resize-active-window] failed to set event hook: %u", GetLastError());
+            return;
+        }
+        // Windows that already exist have had their first show; hiding and
+        // showing one again mustn't resize it.
+        EnumWindows([](HWND hwnd, LPARAM) -> BOOL {
+            g_autoSized.insert(hwnd);
+            return TRUE;
+        }, 0);
+        g_autoSizedSweepAt = std::max(kAutoSizedSweepMin, g_autoSized.size() * 2);
+    }
+}
+
 void HotkeyThreadProc() {
     WNDCLASS wc = {};
     wc.lpfnWndProc   = DefWindowProc;
@@ -160,20 +1209,44 @@ void HotkeyThreadProc() {
     }
     g_msgWindow = hwnd;
 
-    if (!RegisterHotKey(hwnd, HOTKEY_ID, g_hotkeyModifiers, g_hotkeyVk))
-        Wh_Log(L"[resize-active-window] failed to register hotkey: %u", GetLastError());
-    else
-        Wh_Log(L"[resize-active-window] Hotkey registered (mod=0x%X vk=0x%X)", g_hotkeyModifiers, g_hotkeyVk);
+    g_dispatcher.Register(hwnd);
+
+    // Out-of-context events are delivered while this thread pumps messages,
+    // so the loop mustn't filter on the message window.
+    HWINEVENTHOOK autoSizeHook = nullptr;
+    SyncAutoSizeHook(autoSizeHook);
 
     MSG msg;
-    while (g_running && GetMessage(&msg, hwnd, 0, 0) > 0) {
-        if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_ID) {
-            Wh_Log(L"[resize-active-window] hotkey pressed → resizing active window");
-            ResizeActiveWindow();
+    while (g_running && GetMessage(&msg, nullptr, 0, 0) > 0) {
+        if (msg.message == WM_HOTKEY) {
+            switch (g_dispatcher.OnHotkey(hwnd, msg.lParam)) {
+                case ACTION_RESIZE_ACTIVE:
+                    Wh_Log(L"[resize-active-window] hotkey pressed → resizing active window");
+                    ResizeActiveWindow();
+                    break;
+                case ACTION_UNDO:
+                    Wh_Log(L"[resize-active-window] undo hotkey pressed → restoring windows");
+                    UndoLastActions();
+                    break;
+            }
+        } else if (msg.message == WM_TIMER && msg.wParam == CHORD_TIMER_ID) {
+            g_dispatcher.OnTimeout(hwnd);
+        } else if (msg.message == WM_APP_PROCESS_EXITED) {
+            g_autoSizeRules.OnProcessExited((DWORD)msg.wParam);
+        } else if (msg.message == WM_APP_RELOAD_SETTINGS) {
+            // Swap the registrations in place; the thread and window stay.
+            g_dispatcher.Unregister(hwnd);
+            LoadSettings();
+            g_dispatcher.Register(hwnd);
+            SyncAutoSizeHook(autoSizeHook);
+            Wh_Log(L"[resize-active-window] settings reloaded");
         }
     }
 
-    UnregisterHotKey(hwnd, HOTKEY_ID);
+    if (autoSizeHook) UnhookWinEvent(autoSizeHook);
+    g_autoSizeRules.Clear();
+    g_autoSized.clear();
+    g_dispatcher.Unregister(hwnd);
     DestroyWindow(hwnd);
     UnregisterClass(wc.lpszClassName, wc.hInstance);
     g_msgWindow = nullptr;
@@ -188,42 +1261,133 @@ void ResizeActiveWindow() {
 
     DWORD pid = 0;
     GetWindowThreadProcessId(hwnd, &pid);
-    if (pid) {
-        HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
-        if (hProc) {
-            wchar_t fullPath[MAX_PATH] = {};
-            DWORD size = _countof(fullPath);
-            if (QueryFullProcessImageName(hProc, 0, fullPath, &size)) {
-                const wchar_t* exe = wcsrchr(fullPath, L'\\');
-                exe = exe ? exe + 1 : fullPath;
-                // Skip Start menu, Shell Experience Host, Search UI and Search Host
-                if (_wcsicmp(exe, L"ShellExperienceHost.exe") == 0 ||
-                    _wcsicmp(exe, L"StartMenuExperienceHost.exe") == 0 ||
-                    _wcsicmp(exe, L"SearchApp.exe") == 0 ||
-                    _wcsicmp(exe, L"SearchUI.exe") == 0 ||
-                    _wcsicmp(exe, L"SearchHost.exe") == 0 ||
-                    _wcsicmp(exe, L"Rainlendar2.exe") == 0) {
-                    CloseHandle(hProc);
-                    return;
-                }
-            }
-            CloseHandle(hProc);
-        }
+    if (!g_activeFilter.Accept(hwnd, GetWindow(hwnd, GW_OWNER), pid,
+                               (DWORD)GetWindowLongPtr(hwnd, GWL_STYLE), (DWORD)GetWindowLongPtr(hwnd, GWL_EXSTYLE))) {
+        Wh_Log(L"[resize-active-window] skipping the foreground window (filter so far: %s)",
+               g_activeFilter.Report().c_str());
+        return;
     }
-    if (!IsWindowVisible(hwnd) || IsIconic(hwnd)) return;
-    if (GetWindow(hwnd, GW_OWNER) != nullptr) return;
+
+    JournalEntry entry;
+    bool journaled = CaptureJournalEntry(hwnd, {}, entry);
 
     // Restore the window from maximized state
     ShowWindow(hwnd, SW_RESTORE);
 
-    // Get the DPI of the monitor where the window is located
-    UINT dpi = GetDpiForWindow(hwnd);
-    float scalingFactor = static_cast<float>(dpi) / 96.0f; // 96 is the default DPI
+    // Scale every breakpoint for the window's monitor
+    HMONITOR mon = MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST);
+    MONITORINFO mi = { sizeof(mi) };
+    if (!GetMonitorInfo(mon, &mi)) return;
+    UINT dpiX = USER_DEFAULT_SCREEN_DPI, dpiY;
+    GetDpiForMonitor(mon, MDT_EFFECTIVE_DPI, &dpiX, &dpiY);
+    std::vector<SIZE> sizes(g_breakpoints.size());
+    for (size_t i = 0; i < sizes.size(); ++i) sizes[i] = ScaleBreakpoint(g_breakpoints[i], dpiX, mi.rcWork);
 
-    // Scale the desired window size based on the DPI
-    int scaledWidth = static_cast<int>(1440 * scalingFactor);
-    int scaledHeight = static_cast<int>(900 * scalingFactor);
+    // Move on from the breakpoint the window is already at, if any
+    RECT wr = {};
+    GetWindowRect(hwnd, &wr);
+    size_t next = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        if (std::abs(sizes[i].cx - (wr.right - wr.left)) <= 2 && std::abs(sizes[i].cy - (wr.bottom - wr.top)) <= 2) {
+            next = (i + 1) % sizes.size();
+            break;
+        }
+    }
 
     // Resize the window
-    SetWindowPos(hwnd, nullptr, 0, 0, scaledWidth, scaledHeight, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+    SetWindowPos(hwnd, nullptr, 0, 0, sizes[next].cx, sizes[next].cy, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+    Wh_Log(L"[resize-active-window] resized to breakpoint %zu (%ldx%ld)", next + 1, sizes[next].cx, sizes[next].cy);
+
+    if (journaled && GetWindowRect(hwnd, &entry.after)) g_journal.Record({ entry });
+}
+
+void UndoLastActions() {
+    size_t popped = 0;
+    std::vector<JournalEntry> entries = g_journal.Pop(g_undoDepth, popped);
+
+    std::vector<const JournalEntry*> pending;
+    size_t placements = 0;
+    for (const auto& e : entries) {
+        if (!IsWindow(e.hwnd)) continue;
+        if (RestorePlacement(e)) placements++;
+        else pending.push_back(&e);
+    }
+
+    // Put the rest back in one transaction, falling back to individual calls
+    // if any window rejects deferral.
+    if (!pending.empty()) {
+        const UINT flags = SWP_NOZORDER | SWP_NOACTIVATE;
+        HDWP hdwp = BeginDeferWindowPos((int)pending.size());
+        for (const JournalEntry* e : pending) {
+            if (!hdwp) break;
+            hdwp = DeferWindowPos(hdwp, e->hwnd, nullptr, e->before.left, e->before.top,
+                                  e->before.right - e->before.left, e->before.bottom - e->before.top, flags);
+        }
+        if (!hdwp || !EndDeferWindowPos(hdwp)) {
+            for (const JournalEntry* e : pending) {
+                SetWindowPos(e->hwnd, nullptr, e->before.left, e->before.top,
+                             e->before.right - e->before.left, e->before.bottom - e->before.top,
+                             flags | SWP_ASYNCWINDOWPOS);
+            }
+        }
+    }
+
+    Wh_Log(L"[resize-active-window] undo: reverted %zu actions, %zu windows, %zu placements; %zu actions left",
+           popped, pending.size(), placements, g_journal.Actions());
+}
+
+// — Auto-sizing new windows —
+
+BOOL CALLBACK CollectMonitorProc(HMONITOR mon, HDC, LPRECT, LPARAM lp) {
+    ((std::vector<HMONITOR>*)lp)->push_back(mon);
+    return TRUE;
+}
+
+// 1-based, in enumeration order; nullptr if there aren't that many.
+HMONITOR MonitorByNumber(int number) {
+    std::vector<HMONITOR> monitors;
+    EnumDisplayMonitors(nullptr, nullptr, CollectMonitorProc, (LPARAM)&monitors);
+    return number >= 1 && (size_t)number <= monitors.size() ? monitors[number - 1] : nullptr;
+}
+
+void ApplyAutoSizeRule(HWND hwnd, const AutoSizeRule& rule) {
+    HMONITOR mon = rule.monitor ? MonitorByNumber(rule.monitor) : nullptr;
+    bool center = mon != nullptr;
+    if (!mon) mon = MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST);
+    MONITORINFO mi = { sizeof(mi) };
+    if (!GetMonitorInfo(mon, &mi)) return;
+    UINT dpiX = USER_DEFAULT_SCREEN_DPI, dpiY;
+    GetDpiForMonitor(mon, MDT_EFFECTIVE_DPI, &dpiX, &dpiY);
+
+    LONG w = std::min<LONG>(rule.width * dpiX / USER_DEFAULT_SCREEN_DPI, mi.rcWork.right - mi.rcWork.left);
+    LONG h = std::min<LONG>(rule.height * dpiX / USER_DEFAULT_SCREEN_DPI, mi.rcWork.bottom - mi.rcWork.top);
+    LONG x = mi.rcWork.left + (mi.rcWork.right - mi.rcWork.left - w) / 2;
+    LONG y = mi.rcWork.top + (mi.rcWork.bottom - mi.rcWork.top - h) / 2;
+
+    // Async, so a new window that is slow to pump messages can't stall the
+    // hotkey thread.
+    UINT flags = SWP_NOZORDER | SWP_NOACTIVATE | SWP_ASYNCWINDOWPOS;
+    if (!center) flags |= SWP_NOMOVE;
+    SetWindowPos(hwnd, nullptr, x, y, w, h, flags);
+    Wh_Log(L"[resize-active-window] auto-sized %p to %ldx%ld%s", hwnd, w, h, center ? L" (centered)" : L"");
+}
+
+void CALLBACK AutoSizeEventProc(HWINEVENTHOOK, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD, DWORD) {
+    // Carets, cursors and other non-window objects leave here, before any
+    // lookup.
+    if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hwnd) return;
+    if (GetAncestor(hwnd, GA_ROOT) != hwnd) return;
+    // Only the first show of a window counts.
+    if (!g_autoSized.insert(hwnd).second) return;
+    SweepAutoSized();
+    if (GetWindow(hwnd, GW_OWNER) != nullptr || IsIconic(hwnd) || IsZoomed(hwnd)) return;
+    // Menus, tooltips and other tool windows are never sized, so they don't
+    // cost a class or process lookup either.
+    if (GetWindowLongPtr(hwnd, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) return;
+
+    wchar_t className[256];
+    if (!GetClassName(hwnd, className, _countof(className))) return;
+    DWORD pid = 0;
+    GetWindowThreadProcessId(hwnd, &pid);
+    if (const AutoSizeRule* rule = g_autoSizeRules.Match(className, pid)) ApplyAutoSizeRule(hwnd, *rule);
 }
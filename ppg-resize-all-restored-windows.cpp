@@ -1,11 +1,11 @@
 // ==WindhawkMod==
 // @id              ppg-resize-windows
 // @name            PPG - Resize All Restored Windows
-// @description     Resize all visible, non-minimized, non-maximized windows to a default size.
+// @description     Resize all visible, non-minimized, non-maximized windows to a configurable size, cycling through breakpoints.
 // @version         1
 // @author          Pepe Gazzo
 // @include         explorer.exe
-// @compilerOptions -luser32 -lpsapi
+// @compilerOptions -luser32 -lpsapi -lshcore -ldwmapi
 // ==/WindhawkMod==
 
 // ==WindhawkModReadme==
@@ -16,7 +16,9 @@ This mod resizes all visible, restored (non-maximized, non-minimized) windows to
 
 It’s especially useful when reopening apps that remember weird dimensions, or when you want to quickly bring order to a cluttered multi-window setup.
 
-You can customize the hotkey in the mod settings.
+Each press moves on to the next size in the breakpoint list, scaled for each monitor's DPI.
+
+You can customize the hotkey and the breakpoints in the mod settings.
 
 */
 // ==/WindhawkModReadme==
@@ -26,103 +28,1524 @@ You can customize the hotkey in the mod settings.
 /*
 - Hotkey: Ctrl+Shift+Alt+F5
   $name: "Hotkey combination"
-  $description: "The hotkey combination to resize windows. Format: Modifiers+Key, e.g. Ctrl+Shift+Alt+F5"
-  $options:
-    - "Ctrl+Shift+Alt+F1": "Ctrl+Shift+Alt+F1"
-    - "Ctrl+Shift+Alt+F2": "Ctrl+Shift+Alt+F2"
-    - "Ctrl+Shift+Alt+F3": "Ctrl+Shift+Alt+F3"
-    - "Ctrl+Shift+Alt+F4": "Ctrl+Shift+Alt+F4"
-    - "Ctrl+Shift+Alt+F5": "Ctrl+Shift+Alt+F5"
-    - "Ctrl+Shift+Alt+F6": "Ctrl+Shift+Alt+F6"
-    - "Ctrl+Shift+Alt+F7": "Ctrl+Shift+Alt+F7"
-    - "Ctrl+Shift+Alt+F8": "Ctrl+Shift+Alt+F8"
-    - "Ctrl+Shift+Alt+F9": "Ctrl+Shift+Alt+F9"
-    - "Ctrl+Shift+Alt+F10": "Ctrl+Shift+Alt+F10"
-    - "Ctrl+Shift+Alt+F11": "Ctrl+Shift+Alt+F11"
-    - "Ctrl+Shift+Alt+F12": "Ctrl+Shift+Alt+F12"
+  $description: "The hotkey combination to resize windows. Format: Modifiers+Key, e.g. Ctrl+Shift+Alt+F5, or, with chords allowed, a comma-separated chord such as Ctrl+K, Ctrl+M. Keys can be letters, digits, F1-F24, names like Left, Home, PageUp or Num0, punctuation, or 0xNN for any virtual-key code."
+- AllowChords: false
+  $name: Allow chords
+  $description: "Lets hotkeys be comma-separated chords. The first step of every chord, e.g. Ctrl+K, is then taken system-wide, so other applications stop receiving it. Single-step hotkeys work either way."
+- UndoHotkey: ""
+  $name: "Undo hotkey"
+  $description: "Puts back the windows touched by the most recent actions. Same format as the hotkey above; off until set, e.g. Ctrl+Shift+Alt+X."
+- UndoDepth: 1
+  $name: Undo depth
+  $description: How many of the most recent actions one undo press reverts (up to 32)
+- DiagnosticsHotkey: ""
+  $name: "Diagnostics hotkey"
+  $description: "Writes per-phase timings of the last 64 actions to the mod log. Same format as the hotkey above; leave empty to disable."
+- Breakpoints:
+  - 1440x800
+  - 1280x800
+  - 1920x1080
+  $name: Breakpoints
+  $description: Sizes at 100% scaling, written as WIDTHxHEIGHT. Each hotkey press resizes every window to the next one.
+- ExcludedProcesses:
+  - ShellExperienceHost.exe
+  - StartMenuExperienceHost.exe
+  - SearchApp.exe
+  - SearchUI.exe
+  - SearchHost.exe
+  - Rainlendar2.exe
+  $name: Excluded processes
+  $description: Executable names whose windows are never touched (case-insensitive)
+- ExcludedWindowClasses: [""]
+  $name: Excluded window classes
+  $description: Window class names that are never touched (case-insensitive)
 */
 // ==/WindhawkModSettings==
 
 #include <windows.h>
+#include <dwmapi.h>
 #include <psapi.h>
+#include <shellscalingapi.h>  // for GetDpiForMonitor
 #include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cwctype>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
-#include <cwctype>
 
 #define HOTKEY_ID  1
+#define WM_APP_RELOAD_SETTINGS  (WM_APP + 1)
+#define WM_APP_PROCESS_EXITED   (WM_APP + 2)
 
 static std::thread       g_hotkeyThread;
 static std::atomic<HWND> g_msgWindow{ nullptr };
 static std::atomic<bool> g_running{ false };
 
-// Custom hotkey storage (filled in Wh_ModInit)
-static UINT g_hotkeyModifiers = MOD_CONTROL | MOD_SHIFT | MOD_ALT;
-static UINT g_hotkeyVk        = VK_F5;
-
-// Split a L"Mod1+Mod2+Key" string into modifiers & virtual-key
-bool ParseHotkey(const std::wstring& hotkeyStr, UINT& modifiers, UINT& vk) {
-    modifiers = 0;
-    vk = 0;
-    std::vector<std::wstring> tokens;
-    size_t start = 0;
-    while (true) {
-        auto pos = hotkeyStr.find(L'+', start);
-        if (pos == std::wstring::npos) {
-            tokens.push_back(hotkeyStr.substr(start));
+static constexpr wchar_t kDefaultHotkey[] = L"Ctrl+Shift+Alt+F5";
+
+// — Hotkey grammar —
+//
+// Windhawk builds every mod from a single file, so this section, chord
+// dispatch and the exclusion sets are carried verbatim by each PPG hotkey mod.
+// Change every copy together, so a hotkey string means the same key in all of
+// them.
+//
+// A hotkey is a chord of one or more comma-separated steps, each written as
+// Modifiers+Key, e.g. "Ctrl+Shift+Alt+F5" or "Ctrl+K, Ctrl+M". Key names are
+// looked up in kKeyNames; a single letter or digit names itself and "0xNN"
+// names any virtual-key code directly.
+
+struct KeyName {
+    const wchar_t* name;
+    UINT           vk;
+};
+
+static constexpr KeyName kKeyNames[] = {
+    { L"BACKSPACE", VK_BACK },          { L"BACK", VK_BACK },
+    { L"TAB", VK_TAB },                 { L"CLEAR", VK_CLEAR },
+    { L"ENTER", VK_RETURN },            { L"RETURN", VK_RETURN },
+    { L"PAUSE", VK_PAUSE },             { L"CAPSLOCK", VK_CAPITAL },
+    { L"ESC", VK_ESCAPE },              { L"ESCAPE", VK_ESCAPE },
+    { L"SPACE", VK_SPACE },
+    { L"PAGEUP", VK_PRIOR },            { L"PGUP", VK_PRIOR },
+    { L"PAGEDOWN", VK_NEXT },           { L"PGDN", VK_NEXT },
+    { L"END", VK_END },                 { L"HOME", VK_HOME },
+    { L"LEFT", VK_LEFT },               { L"UP", VK_UP },
+    { L"RIGHT", VK_RIGHT },             { L"DOWN", VK_DOWN },
+    { L"SELECT", VK_SELECT },           { L"PRINT", VK_PRINT },
+    { L"EXECUTE", VK_EXECUTE },
+    { L"PRINTSCREEN", VK_SNAPSHOT },    { L"PRTSC", VK_SNAPSHOT },
+    { L"INSERT", VK_INSERT },           { L"INS", VK_INSERT },
+    { L"DELETE", VK_DELETE },           { L"DEL", VK_DELETE },
+    { L"HELP", VK_HELP },
+    { L"APPS", VK_APPS },               { L"MENU", VK_APPS },
+    { L"SLEEP", VK_SLEEP },
+    { L"NUM0", VK_NUMPAD0 },            { L"NUM1", VK_NUMPAD1 },
+    { L"NUM2", VK_NUMPAD2 },            { L"NUM3", VK_NUMPAD3 },
+    { L"NUM4", VK_NUMPAD4 },            { L"NUM5", VK_NUMPAD5 },
+    { L"NUM6", VK_NUMPAD6 },            { L"NUM7", VK_NUMPAD7 },
+    { L"NUM8", VK_NUMPAD8 },            { L"NUM9", VK_NUMPAD9 },
+    { L"MULTIPLY", VK_MULTIPLY },       { L"ADD", VK_ADD },
+    { L"SEPARATOR", VK_SEPARATOR },     { L"SUBTRACT", VK_SUBTRACT },
+    { L"DECIMAL", VK_DECIMAL },         { L"DIVIDE", VK_DIVIDE },
+    { L"F1", VK_F1 },                   { L"F2", VK_F2 },
+    { L"F3", VK_F3 },                   { L"F4", VK_F4 },
+    { L"F5", VK_F5 },                   { L"F6", VK_F6 },
+    { L"F7", VK_F7 },                   { L"F8", VK_F8 },
+    { L"F9", VK_F9 },                   { L"F10", VK_F10 },
+    { L"F11", VK_F11 },                 { L"F12", VK_F12 },
+    { L"F13", VK_F13 },                 { L"F14", VK_F14 },
+    { L"F15", VK_F15 },                 { L"F16", VK_F16 },
+    { L"F17", VK_F17 },                 { L"F18", VK_F18 },
+    { L"F19", VK_F19 },                 { L"F20", VK_F20 },
+    { L"F21", VK_F21 },                 { L"F22", VK_F22 },
+    { L"F23", VK_F23 },                 { L"F24", VK_F24 },
+    { L"NUMLOCK", VK_NUMLOCK },         { L"SCROLLLOCK", VK_SCROLL },
+    { L"BROWSERBACK", VK_BROWSER_BACK },
+    { L"BROWSERFORWARD", VK_BROWSER_FORWARD },
+    { L"BROWSERREFRESH", VK_BROWSER_REFRESH },
+    { L"BROWSERSTOP", VK_BROWSER_STOP },
+    { L"BROWSERSEARCH", VK_BROWSER_SEARCH },
+    { L"BROWSERFAVORITES", VK_BROWSER_FAVORITES },
+    { L"BROWSERHOME", VK_BROWSER_HOME },
+    { L"VOLUMEMUTE", VK_VOLUME_MUTE },  { L"VOLUMEDOWN", VK_VOLUME_DOWN },
+    { L"VOLUMEUP", VK_VOLUME_UP },
+    { L"MEDIANEXT", VK_MEDIA_NEXT_TRACK },
+    { L"MEDIAPREV", VK_MEDIA_PREV_TRACK },
+    { L"MEDIASTOP", VK_MEDIA_STOP },
+    { L"MEDIAPLAYPAUSE", VK_MEDIA_PLAY_PAUSE },
+    { L"LAUNCHMAIL", VK_LAUNCH_MAIL },
+    { L"LAUNCHMEDIA", VK_LAUNCH_MEDIA_SELECT },
+    { L"LAUNCHAPP1", VK_LAUNCH_APP1 },  { L"LAUNCHAPP2", VK_LAUNCH_APP2 },
+    // OEM keys, named after their US-layout legends. "+" and "," separate
+    // steps, so those two keys are only reachable by name.
+    { L";", VK_OEM_1 },                 { L"SEMICOLON", VK_OEM_1 },
+    { L"=", VK_OEM_PLUS },              { L"PLUS", VK_OEM_PLUS },
+    { L"COMMA", VK_OEM_COMMA },
+    { L"-", VK_OEM_MINUS },             { L"MINUS", VK_OEM_MINUS },
+    { L".", VK_OEM_PERIOD },            { L"PERIOD", VK_OEM_PERIOD },
+    { L"/", VK_OEM_2 },                 { L"SLASH", VK_OEM_2 },
+    { L"`", VK_OEM_3 },                 { L"BACKTICK", VK_OEM_3 },
+    { L"[", VK_OEM_4 },                 { L"LBRACKET", VK_OEM_4 },
+    { L"\\", VK_OEM_5 },                { L"BACKSLASH", VK_OEM_5 },
+    { L"]", VK_OEM_6 },                 { L"RBRACKET", VK_OEM_6 },
+    { L"'", VK_OEM_7 },                 { L"QUOTE", VK_OEM_7 },
+    { L"OEM8", VK_OEM_8 },              { L"OEM102", VK_OEM_102 },
+};
+
+constexpr size_t kMaxChordSteps = 4;
+
+struct HotkeyStep {
+    UINT modifiers;
+    UINT vk;
+};
+
+struct HotkeyChord {
+    HotkeyStep steps[kMaxChordSteps];
+    size_t     count;
+};
+
+static wchar_t AsciiUpper(wchar_t c) {
+    return (c >= L'a' && c <= L'z') ? wchar_t(c - L'a' + L'A') : c;
+}
+
+static bool EqualsNoCase(std::wstring_view a, const wchar_t* b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i) {
+        if (AsciiUpper(a[i]) != AsciiUpper(b[i])) return false;
+    }
+    return i == a.size() && !b[i];
+}
+
+static std::wstring_view TrimSpaces(std::wstring_view s) {
+    while (!s.empty() && s.front() == L' ') s.remove_prefix(1);
+    while (!s.empty() && s.back() == L' ')  s.remove_suffix(1);
+    return s;
+}
+
+static UINT LookupModifier(std::wstring_view tok) {
+    if (EqualsNoCase(tok, L"SHIFT"))                                 return MOD_SHIFT;
+    if (EqualsNoCase(tok, L"CTRL") || EqualsNoCase(tok, L"CONTROL")) return MOD_CONTROL;
+    if (EqualsNoCase(tok, L"ALT"))                                   return MOD_ALT;
+    if (EqualsNoCase(tok, L"WIN") || EqualsNoCase(tok, L"WINDOWS"))  return MOD_WIN;
+    return 0;
+}
+
+static UINT LookupKey(std::wstring_view tok) {
+    if (tok.size() == 1) {
+        wchar_t c = AsciiUpper(tok[0]);
+        if ((c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9')) return c;
+    }
+    if (tok.size() > 2 && tok[0] == L'0' && AsciiUpper(tok[1]) == L'X') {
+        UINT vk = 0;
+        for (size_t i = 2; i < tok.size(); ++i) {
+            wchar_t c = AsciiUpper(tok[i]);
+            if (c >= L'0' && c <= L'9')      vk = vk * 16 + (c - L'0');
+            else if (c >= L'A' && c <= L'F') vk = vk * 16 + (c - L'A' + 10);
+            else return 0;
+            if (vk > 0xFE) return 0;
+        }
+        return vk;
+    }
+    for (const auto& key : kKeyNames) {
+        if (EqualsNoCase(tok, key.name)) return key.vk;
+    }
+    return 0;
+}
+
+// Parse a single Modifiers+Key step. Unknown modifiers or keys fail the
+// whole step instead of being dropped.
+static bool ParseHotkeyStep(std::wstring_view s, HotkeyStep& step) {
+    step = {};
+    for (size_t pos; (pos = s.find(L'+')) != std::wstring_view::npos; s.remove_prefix(pos + 1)) {
+        UINT mod = LookupModifier(TrimSpaces(s.substr(0, pos)));
+        if (!mod) return false;
+        step.modifiers |= mod;
+    }
+    step.vk = LookupKey(TrimSpaces(s));
+    return step.vk != 0;
+}
+
+// Split a L"Mod1+Mod2+Key, Mod1+Key" string into chord steps
+bool ParseHotkey(std::wstring_view s, HotkeyChord& chord) {
+    chord = {};
+    while (chord.count < kMaxChordSteps) {
+        size_t pos = s.find(L',');
+        if (!ParseHotkeyStep(s.substr(0, pos), chord.steps[chord.count])) return false;
+        chord.count++;
+        if (pos == std::wstring_view::npos) return true;
+        s.remove_prefix(pos + 1);
+    }
+    return false;
+}
+
+// — Chord dispatch —
+//
+// Bindings form a trie keyed by packed (modifiers, vk) steps, so every
+// WM_HOTKEY is one hash lookup from the current state. The first step of
+// each binding stays registered; deeper steps are registered only while a
+// chord is in progress and are dropped again when it completes or times out.
+// A registered first step is taken from every other application, so chords
+// are only bound when the AllowChords setting asks for them.
+
+#define CHORD_HOTKEY_ID_BASE  0x100
+#define CHORD_TIMER_ID        1
+
+constexpr UINT kChordTimeoutMs = 1500;
+
+static UINT PackHotkeyStep(UINT modifiers, UINT vk) {
+    return (modifiers & 0xFFFF) << 16 | (vk & 0xFFFF);
+}
+
+class HotkeyDispatcher {
+public:
+    void Clear() {
+        nodes.assign(1, Node{});
+        state = 0;
+    }
+
+    // Fails if the chord is a prefix of, or prefixed by, an existing binding.
+    bool Add(const HotkeyChord& chord, int action) {
+        size_t node = 0;
+        for (size_t i = 0; i < chord.count; ++i) {
+            if (nodes[node].action >= 0) return false;
+            UINT key = PackHotkeyStep(chord.steps[i].modifiers, chord.steps[i].vk);
+            auto it = nodes[node].next.find(key);
+            size_t child;
+            if (it != nodes[node].next.end()) {
+                child = it->second;
+            } else {
+                child = nodes.size();
+                nodes.emplace_back();
+                nodes[node].next.emplace(key, child);
+            }
+            node = child;
+        }
+        if (node == 0 || nodes[node].action >= 0 || !nodes[node].next.empty()) return false;
+        nodes[node].action = action;
+        return true;
+    }
+
+    void Register(HWND hwnd) {
+        int id = HOTKEY_ID;
+        for (const auto& [key, child] : nodes[0].next) {
+            if (!RegisterHotKey(hwnd, id, HIWORD(key), LOWORD(key)))
+                Wh_Log(L"[resize-windows] failed to register hotkey (mod=0x%X vk=0x%X): %u", HIWORD(key), LOWORD(key), GetLastError());
+            else
+                Wh_Log(L"[resize-windows] Hotkey registered (mod=0x%X vk=0x%X)", HIWORD(key), LOWORD(key));
+            id++;
+        }
+        rootCount = id - HOTKEY_ID;
+    }
+
+    void Unregister(HWND hwnd) {
+        ResetState(hwnd);
+        for (int i = 0; i < rootCount; ++i) UnregisterHotKey(hwnd, HOTKEY_ID + i);
+        rootCount = 0;
+    }
+
+    // Feed a WM_HOTKEY; returns the completed binding's action, or -1.
+    int OnHotkey(HWND hwnd, LPARAM lParam) {
+        UINT key = PackHotkeyStep(LOWORD(lParam), HIWORD(lParam));
+        auto it = nodes[state].next.find(key);
+        if (it == nodes[state].next.end() && state != 0) {
+            // Not a continuation: abandon the chord and retry as a first step.
+            ResetState(hwnd);
+            it = nodes[0].next.find(key);
+        }
+        if (it == nodes[state].next.end()) return -1;
+        size_t node = it->second;
+        if (nodes[node].action >= 0) {
+            ResetState(hwnd);
+            return nodes[node].action;
+        }
+        EnterState(hwnd, node);
+        return -1;
+    }
+
+    void OnTimeout(HWND hwnd) {
+        ResetState(hwnd);
+    }
+
+private:
+    struct Node {
+        int action = -1;
+        std::unordered_map<UINT, size_t> next;
+    };
+
+    std::vector<Node> nodes = std::vector<Node>(1);
+    size_t state = 0;
+    int rootCount = 0;
+    int pendingCount = 0;
+
+    void EnterState(HWND hwnd, size_t node) {
+        ResetState(hwnd);
+        state = node;
+        for (const auto& [key, child] : nodes[node].next) {
+            // Keys that are also first steps are registered already.
+            if (nodes[0].next.count(key)) continue;
+            RegisterHotKey(hwnd, CHORD_HOTKEY_ID_BASE + pendingCount, HIWORD(key), LOWORD(key));
+            pendingCount++;
+        }
+        SetTimer(hwnd, CHORD_TIMER_ID, kChordTimeoutMs, nullptr);
+    }
+
+    void ResetState(HWND hwnd) {
+        if (state == 0) return;
+        for (int i = 0; i < pendingCount; ++i) UnregisterHotKey(hwnd, CHORD_HOTKEY_ID_BASE + i);
+        pendingCount = 0;
+        KillTimer(hwnd, CHORD_TIMER_ID);
+        state = 0;
+    }
+};
+
+// — Exclusion sets —
+//
+// Excluded executable and window class names come from the settings and are
+// compiled at load into a case-folded perfect hash (hash-and-displace): every
+// name gets its own slot through a per-bucket displacement, so a lookup is one
+// string hash and at most one compare however many names are configured. If
+// no displacement fits, the names are kept sorted and binary-searched instead.
+
+static wchar_t FoldChar(wchar_t c) {
+    if (c < 0x80) return (c >= L'A' && c <= L'Z') ? wchar_t(c - L'A' + L'a') : c;
+    return (wchar_t)towlower(c);
+}
+
+static unsigned long long HashFolded(const wchar_t* s) {
+    unsigned long long h = 14695981039346656037ull;    // FNV-1a
+    for (; *s; ++s) {
+        h ^= FoldChar(*s);
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;                                      // murmur3 finalizer
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+class NameSet {
+public:
+    void Build(const std::vector<std::wstring>& names) {
+        std::vector<std::wstring> folded;
+        for (const auto& name : names) {
+            std::wstring f = name;
+            for (auto& c : f) c = FoldChar(c);
+            if (!f.empty() && std::find(folded.begin(), folded.end(), f) == folded.end())
+                folded.push_back(std::move(f));
+        }
+        slots.clear();
+        displacements.clear();
+        sorted.clear();
+        count = 0;
+        if (folded.empty()) return;
+
+        size_t bucketCount = 1;
+        while (bucketCount < folded.size()) bucketCount <<= 1;
+        for (size_t slotCount = bucketCount * 2; slotCount <= bucketCount * 64; slotCount <<= 1) {
+            if (TryBuild(folded, bucketCount, slotCount)) return;
+        }
+        Wh_Log(L"[resize-windows] no perfect hash for %zu names, falling back to a sorted list", folded.size());
+        slots.clear();
+        displacements.clear();
+        std::sort(folded.begin(), folded.end());
+        sorted = std::move(folded);
+        count = sorted.size();
+    }
+
+    bool Empty() const { return count == 0; }
+    size_t Size() const { return count; }
+
+    bool Contains(const wchar_t* name) const {
+        if (!sorted.empty()) {
+            std::wstring folded = name;
+            for (auto& c : folded) c = FoldChar(c);
+            return std::binary_search(sorted.begin(), sorted.end(), folded);
+        }
+        if (slots.empty()) return false;
+        unsigned long long h = HashFolded(name);
+        UINT d = displacements[h & (displacements.size() - 1)];
+        const std::wstring& slot = slots[Slot(h, d, slots.size())];
+        size_t i = 0;
+        for (; name[i] && i < slot.size(); ++i) {
+            if (FoldChar(name[i]) != slot[i]) return false;
+        }
+        return !name[i] && i == slot.size();
+    }
+
+private:
+    std::vector<std::wstring> slots;      // folded names, empty = free
+    std::vector<UINT> displacements;      // one per bucket
+    std::vector<std::wstring> sorted;     // folded names, when no hash fits
+    size_t count = 0;
+
+    // h2 is odd and the slot count a power of two, so d walks every slot.
+    static size_t Slot(unsigned long long h, UINT d, size_t slotCount) {
+        UINT h1 = (UINT)(h >> 32);
+        UINT h2 = (UINT)(h >> 8) | 1;
+        return (h1 + d * h2) & (slotCount - 1);
+    }
+
+    bool TryBuild(const std::vector<std::wstring>& names, size_t bucketCount, size_t slotCount) {
+        std::vector<std::vector<unsigned long long>> buckets(bucketCount);
+        for (const auto& name : names) {
+            unsigned long long h = HashFolded(name.c_str());
+            buckets[h & (bucketCount - 1)].push_back(h);
+        }
+        std::vector<size_t> order(bucketCount);
+        for (size_t i = 0; i < bucketCount; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        // Place the largest buckets first, trying displacements until all of
+        // a bucket's names land in distinct free slots.
+        std::vector<bool> used(slotCount);
+        displacements.assign(bucketCount, 0);
+        for (size_t b : order) {
+            const auto& bucket = buckets[b];
+            if (bucket.empty()) break;
+            bool placed = false;
+            for (UINT d = 0; d < slotCount && !placed; ++d) {
+                std::vector<size_t> taken;
+                for (auto h : bucket) {
+                    size_t s = Slot(h, d, slotCount);
+                    if (used[s] || std::find(taken.begin(), taken.end(), s) != taken.end()) break;
+                    taken.push_back(s);
+                }
+                if (taken.size() != bucket.size()) continue;
+                for (size_t s : taken) used[s] = true;
+                displacements[b] = d;
+                placed = true;
+            }
+            if (!placed) return false;
+        }
+
+        slots.assign(slotCount, std::wstring());
+        for (const auto& name : names) {
+            unsigned long long h = HashFolded(name.c_str());
+            slots[Slot(h, displacements[h & (bucketCount - 1)], slotCount)] = name;
+        }
+        count = names.size();
+        return true;
+    }
+};
+
+static NameSet g_excludedProcesses;
+static NameSet g_excludedClasses;
+
+// Read a string-array setting such as L"ExcludedProcesses"; the list ends at
+// the first empty entry.
+static std::vector<std::wstring> LoadStringList(PCWSTR name) {
+    std::vector<std::wstring> items;
+    for (int i = 0;; ++i) {
+        PCWSTR value = Wh_GetStringSetting(L"%s[%d]", name, i);
+        bool end = !value || !*value;
+        if (!end) items.push_back(value);
+        if (value) Wh_FreeStringSetting(value);
+        if (end) break;
+    }
+    return items;
+}
+
+// — Breakpoints —
+//
+// The sizes the hotkey cycles through, written as WIDTHxHEIGHT at 100%
+// scaling and scaled by the DPI of each window's monitor.
+
+static std::vector<SIZE> g_breakpoints;
+
+static bool ParseDimension(std::wstring_view s, LONG& value) {
+    s = TrimSpaces(s);
+    if (s.empty() || s.size() > 5) return false;
+    value = 0;
+    for (wchar_t c : s) {
+        if (c < L'0' || c > L'9') return false;
+        value = value * 10 + (c - L'0');
+    }
+    return value > 0;
+}
+
+static bool ParseBreakpoint(std::wstring_view s, SIZE& size) {
+    size_t x = s.find_first_of(L"xX×*");
+    return x != std::wstring_view::npos &&
+           ParseDimension(s.substr(0, x), size.cx) && ParseDimension(s.substr(x + 1), size.cy);
+}
+
+static void LoadBreakpoints(SIZE fallback) {
+    g_breakpoints.clear();
+    for (const auto& item : LoadStringList(L"Breakpoints")) {
+        SIZE size;
+        if (ParseBreakpoint(item, size)) g_breakpoints.push_back(size);
+        else Wh_Log(L"[resize-windows] ignoring breakpoint '%s'", item.c_str());
+    }
+    if (g_breakpoints.empty()) g_breakpoints.push_back(fallback);
+}
+
+// Scales a breakpoint to a monitor's DPI, capped at its work area.
+static SIZE ScaleBreakpoint(SIZE size, UINT dpi, const RECT& work) {
+    size.cx = std::min<LONG>(MulDiv(size.cx, dpi, USER_DEFAULT_SCREEN_DPI), work.right - work.left);
+    size.cy = std::min<LONG>(MulDiv(size.cy, dpi, USER_DEFAULT_SCREEN_DPI), work.bottom - work.top);
+    return size;
+}
+
+// — Monitor table —
+//
+// Work area and effective DPI of every monitor, snapshotted once per action
+// so per-window scaling is a table lookup.
+
+struct MonitorGeometry {
+    RECT work;
+    UINT dpi;
+};
+
+struct MonitorTable {
+    std::vector<HMONITOR>        handles;
+    std::vector<RECT>            bounds;
+    std::vector<MonitorGeometry> geometry;
+
+    // MonitorFromRect(MONITOR_DEFAULTTONEAREST) over the snapshot: the
+    // monitor with the largest overlap, else the closest one.
+    UINT IndexOfRect(const RECT& r) const {
+        UINT best = 0;
+        long long bestArea = 0, bestDistance = LLONG_MAX;
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            const RECT& b = bounds[i];
+            long long w = std::min(r.right, b.right) - std::max(r.left, b.left);
+            long long h = std::min(r.bottom, b.bottom) - std::max(r.top, b.top);
+            if (w > 0 && h > 0) {
+                if (w * h > bestArea) {
+                    bestArea = w * h;
+                    best = (UINT)i;
+                }
+                continue;
+            }
+            if (bestArea) continue;
+            long long dx = std::max<long long>({ 0, b.left - r.right, r.left - b.right });
+            long long dy = std::max<long long>({ 0, b.top - r.bottom, r.top - b.bottom });
+            if (dx * dx + dy * dy < bestDistance) {
+                bestDistance = dx * dx + dy * dy;
+                best = (UINT)i;
+            }
+        }
+        return best;
+    }
+};
+
+static BOOL CALLBACK CollectMonitorProc(HMONITOR mon, HDC, LPRECT, LPARAM lp) {
+    auto& table = *(MonitorTable*)lp;
+    MONITORINFO mi = { sizeof(mi) };
+    if (!GetMonitorInfo(mon, &mi)) return TRUE;
+    UINT dpiX = USER_DEFAULT_SCREEN_DPI, dpiY;
+    GetDpiForMonitor(mon, MDT_EFFECTIVE_DPI, &dpiX, &dpiY);
+    table.handles.push_back(mon);
+    table.bounds.push_back(mi.rcMonitor);
+    table.geometry.push_back({ mi.rcWork, dpiX });
+    return TRUE;
+}
+
+static MonitorTable BuildMonitorTable() {
+    MonitorTable table;
+    EnumDisplayMonitors(nullptr, nullptr, CollectMonitorProc, (LPARAM)&table);
+    return table;
+}
+
+// — Action timing —
+//
+// Each hotkey action is timed with QueryPerformanceCounter from the moment
+// the WM_HOTKEY was pulled off the queue to the last window handed to the
+// positioning pass, split into phases. The last kTimingRingSize actions are
+// kept in a ring that the diagnostics hotkey dumps to the log, along with
+// per-phase averages.
+
+enum TimingPhase {
+    PHASE_DISPATCH,         // WM_HOTKEY to the start of the action
+    PHASE_ENUMERATE,
+    PHASE_FILTER,           // excluding process queries
+    PHASE_PROCESS_QUERY,
+    PHASE_LAYOUT,
+    PHASE_JOURNAL,
+    PHASE_POSITION,
+    PHASE_COUNT,
+};
+
+static constexpr const wchar_t* kPhaseNames[PHASE_COUNT] = {
+    L"dispatch", L"enumerate", L"filter", L"process", L"layout", L"journal", L"position",
+};
+
+constexpr size_t kTimingRingSize = 64;
+
+static LONGLONG QpcNow() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+static LONGLONG QpcFrequency() {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return freq.QuadPart;
+}
+
+struct ActionTiming {
+    const wchar_t* action = L"";
+    LONGLONG received = 0;
+    LONGLONG last = 0;
+    LONGLONG ticks[PHASE_COUNT] = {};
+    size_t   windows = 0;       // considered
+    size_t   moved = 0;
+
+    void Start(const wchar_t* name, LONGLONG receivedAt) {
+        *this = {};
+        action = name;
+        received = last = receivedAt;
+    }
+
+    // Charges the time since the previous mark to `phase`.
+    void Mark(TimingPhase phase) {
+        LONGLONG now = QpcNow();
+        ticks[phase] += now - last;
+        last = now;
+    }
+
+    // Moves time already charged to one phase over to another.
+    void Shift(TimingPhase from, TimingPhase to, LONGLONG amount) {
+        amount = std::min(amount, ticks[from]);
+        ticks[from] -= amount;
+        ticks[to] += amount;
+    }
+
+    LONGLONG Total() const { return last - received; }
+};
+
+class TimingRing {
+public:
+    void Push(const ActionTiming& timing) {
+        ring[(first + count) % kTimingRingSize] = timing;
+        if (count < kTimingRingSize) count++;
+        else first = (first + 1) % kTimingRingSize;
+    }
+
+    void Dump() const {
+        LONGLONG freq = QpcFrequency();
+        auto us = [&](LONGLONG ticks) { return (long long)(ticks * 1000000 / freq); };
+
+        LONGLONG sums[PHASE_COUNT] = {};
+        for (size_t i = 0; i < count; ++i) {
+            const ActionTiming& t = ring[(first + i) % kTimingRingSize];
+            std::wstring line = L"[resize-windows] #" + std::to_wstring(i + 1) + L" " + t.action + L": " +
+                                std::to_wstring(t.moved) + L"/" + std::to_wstring(t.windows) + L" windows, " +
+                                std::to_wstring(us(t.Total())) + L" us =";
+            for (int p = 0; p < PHASE_COUNT; ++p) {
+                line += L" " + std::wstring(kPhaseNames[p]) + L" " + std::to_wstring(us(t.ticks[p]));
+                sums[p] += t.ticks[p];
+            }
+            Wh_Log(L"%s", line.c_str());
+        }
+        if (!count) {
+            Wh_Log(L"[resize-windows] no actions timed yet");
+            return;
+        }
+        std::wstring line = L"[resize-windows] average over " + std::to_wstring(count) + L" actions (us):";
+        for (int p = 0; p < PHASE_COUNT; ++p)
+            line += L" " + std::wstring(kPhaseNames[p]) + L" " + std::to_wstring(us(sums[p]) / (long long)count);
+        Wh_Log(L"%s", line.c_str());
+    }
+
+private:
+    ActionTiming ring[kTimingRingSize];
+    size_t first = 0, count = 0;
+};
+
+// Only touched from the hotkey thread.
+static TimingRing   g_timings;
+static ActionTiming g_timing;
+
+// — Process image cache —
+//
+// The exclusion check needs every window's executable name, and opening the
+// owning process once per enumerated window dominates a hotkey press on a
+// busy desktop. Names are cached per PID instead. Each entry holds a
+// SYNCHRONIZE handle, which keeps the PID from being recycled while the entry
+// lives, so a cached name can't end up describing a newer process. A thread
+// pool wait on that handle posts WM_APP_PROCESS_EXITED to the hotkey thread
+// when the process exits, and the entry is evicted there.
+
+struct ProcessInfo {
+    HANDLE       process;
+    HANDLE       exitWait;
+    std::wstring exeName;
+};
+
+class ProcessInfoCache {
+public:
+    UINT hits = 0;
+    UINT misses = 0;
+    UINT evictions = 0;
+    LONGLONG queryTicks = 0;    // QPC ticks spent opening and querying processes
+
+    // Returns nullptr if the process can't be queried; failures aren't cached.
+    const ProcessInfo* Lookup(DWORD pid) {
+        auto it = entries.find(pid);
+        if (it != entries.end()) {
+            hits++;
+            return &it->second;
+        }
+        misses++;
+
+        LONGLONG start = QpcNow();
+        const ProcessInfo* info = Query(pid);
+        queryTicks += QpcNow() - start;
+        return info;
+    }
+
+    // Handles WM_APP_PROCESS_EXITED for `pid`.
+    void OnExited(DWORD pid) {
+        auto it = entries.find(pid);
+        if (it == entries.end() || WaitForSingleObject(it->second.process, 0) == WAIT_TIMEOUT) return;
+        Release(it->second);
+        entries.erase(it);
+        evictions++;
+    }
+
+    void Clear() {
+        for (auto& [pid, info] : entries) Release(info);
+        entries.clear();
+    }
+
+    size_t Size() const { return entries.size(); }
+
+private:
+    std::unordered_map<DWORD, ProcessInfo> entries;
+    ProcessInfo uncachedInfo = {};
+
+    static void CALLBACK OnProcessExit(PVOID context, BOOLEAN) {
+        if (HWND hwnd = g_msgWindow) PostMessage(hwnd, WM_APP_PROCESS_EXITED, (WPARAM)context, 0);
+    }
+
+    static void Release(ProcessInfo& info) {
+        // Blocks until a callback already under way returns, so none runs
+        // after the mod unloads.
+        UnregisterWaitEx(info.exitWait, INVALID_HANDLE_VALUE);
+        CloseHandle(info.process);
+    }
+
+    const ProcessInfo* Query(DWORD pid) {
+        HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, pid);
+        if (!hProc) return nullptr;
+
+        ProcessInfo info = { hProc };
+        wchar_t fullPath[MAX_PATH] = {};
+        DWORD size = _countof(fullPath);
+        if (!QueryFullProcessImageName(hProc, 0, fullPath, &size)) {
+            CloseHandle(hProc);
+            return nullptr;
+        }
+        const wchar_t* exe = wcsrchr(fullPath, L'\\');
+        info.exeName = exe ? exe + 1 : fullPath;
+
+        // Without an exit wait nothing would evict the entry, so the name is
+        // handed out uncached.
+        if (!RegisterWaitForSingleObject(&info.exitWait, hProc, OnProcessExit, (PVOID)(UINT_PTR)pid,
+                                         INFINITE, WT_EXECUTEONLYONCE)) {
+            CloseHandle(hProc);
+            uncachedInfo = { nullptr, nullptr, std::move(info.exeName) };
+            return &uncachedInfo;
+        }
+        return &entries.emplace(pid, std::move(info)).first->second;
+    }
+};
+
+// Only touched from the hotkey thread.
+static ProcessInfoCache g_processCache;
+
+// — Window snapshot —
+//
+// One pass over the top-level windows captures what the filters and layouts
+// look at into parallel arrays, so they run over plain memory instead of
+// interleaving several user32 calls per window. The capture is templated over
+// its window source: DesktopWindowSource enumerates the real desktop, and any
+// other callable of the same shape (a canned list of WindowFacts, say) drives
+// the capture and monitor assignment with no window manager behind it. The
+// window filter below still asks DWM, user32 and the process cache directly,
+// so it only runs against real windows.
+
+struct WindowFacts {
+    HWND  hwnd;
+    HWND  owner;
+    DWORD pid;
+    DWORD tid;
+    DWORD style;
+    DWORD exStyle;
+    RECT  rect;
+};
+
+struct WindowSnapshot {
+    std::vector<HWND>  hwnd;
+    std::vector<HWND>  owner;
+    std::vector<DWORD> pid;
+    std::vector<DWORD> tid;
+    std::vector<DWORD> style;
+    std::vector<DWORD> exStyle;
+    std::vector<RECT>  rect;
+    std::vector<UINT>  monitor;     // empty until AssignMonitors
+
+    size_t Size() const { return hwnd.size(); }
+
+    void Reserve(size_t n) {
+        hwnd.reserve(n);
+        owner.reserve(n);
+        pid.reserve(n);
+        tid.reserve(n);
+        style.reserve(n);
+        exStyle.reserve(n);
+        rect.reserve(n);
+    }
+
+    void Push(const WindowFacts& f) {
+        hwnd.push_back(f.hwnd);
+        owner.push_back(f.owner);
+        pid.push_back(f.pid);
+        tid.push_back(f.tid);
+        style.push_back(f.style);
+        exStyle.push_back(f.exStyle);
+        rect.push_back(f.rect);
+    }
+
+    // `monitorOf` maps a rect to a monitor index.
+    template <typename MonitorOf>
+    void AssignMonitors(MonitorOf&& monitorOf) {
+        monitor.resize(rect.size());
+        for (size_t i = 0; i < rect.size(); ++i) monitor[i] = monitorOf(rect[i]);
+    }
+};
+
+// A source is called with an `emit(const WindowFacts&)` callback and calls
+// it once per top-level window, in z-order.
+template <typename Source>
+WindowSnapshot CaptureWindowSnapshot(Source&& source) {
+    WindowSnapshot snap;
+    snap.Reserve(256);
+    source([&](const WindowFacts& f) { snap.Push(f); });
+    return snap;
+}
+
+template <typename Emit>
+static BOOL CALLBACK EmitWindowProc(HWND hwnd, LPARAM lp) {
+    WindowFacts f = { hwnd, GetWindow(hwnd, GW_OWNER) };
+    f.tid     = GetWindowThreadProcessId(hwnd, &f.pid);
+    f.style   = (DWORD)GetWindowLongPtr(hwnd, GWL_STYLE);
+    f.exStyle = (DWORD)GetWindowLongPtr(hwnd, GWL_EXSTYLE);
+    if (GetWindowRect(hwnd, &f.rect)) (*(Emit*)lp)(f);
+    return TRUE;
+}
+
+struct DesktopWindowSource {
+    template <typename Emit>
+    void operator()(Emit&& emit) const {
+        EnumWindows(EmitWindowProc<std::remove_reference_t<Emit>>, (LPARAM)&emit);
+    }
+};
+
+// Whether the process's executable is in `processes`; unqueryable processes
+// aren't excluded.
+static bool IsProcessExcluded(DWORD pid, const NameSet& processes) {
+    if (!pid) return false;
+    const ProcessInfo* info = g_processCache.Lookup(pid);
+    return info && processes.Contains(info->exeName.c_str());
+}
+
+// — Window filter —
+//
+// Which windows an action takes is described once as a FilterSpec and
+// compiled into a WindowFilter: a list of stages ordered from cheapest to
+// most expensive, leaving out stages the spec doesn't use. Style and owner
+// tests read values already in hand, cloaking is one DWM call, the class set
+// needs GetClassName, and the executable set needs a process query, so a
+// window is rejected by the cheapest test that can reject it. Rejections are
+// counted per stage.
+
+enum FilterStage {
+    STAGE_STYLE,
+    STAGE_EXSTYLE,
+    STAGE_OWNER,
+    STAGE_CLOAK,
+    STAGE_CLASS,
+    STAGE_PROCESS,
+    STAGE_COUNT,
+};
+
+static constexpr const wchar_t* kStageNames[STAGE_COUNT] = {
+    L"style", L"exstyle", L"owner", L"cloak", L"class", L"process",
+};
+
+struct FilterSpec {
+    DWORD styleMask = 0, styleValue = 0;        // (style & mask) == value
+    DWORD exStyleMask = 0, exStyleValue = 0;
+    bool  unowned = false;
+    bool  uncloaked = false;
+    const NameSet* excludedClasses = nullptr;
+    const NameSet* excludedProcesses = nullptr;
+};
+
+// https://devblogs.microsoft.com/oldnewthing/20200302-00/?p=103507
+static bool IsWindowCloaked(HWND hwnd) {
+    BOOL isCloaked = FALSE;
+    return SUCCEEDED(DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &isCloaked, sizeof(isCloaked))) && isCloaked;
+}
+
+class WindowFilter {
+public:
+    UINT passed = 0;
+    UINT rejected[STAGE_COUNT] = {};
+
+    void Compile(const FilterSpec& filterSpec) {
+        spec = filterSpec;
+        stageCount = 0;
+        if (spec.styleMask)   stages[stageCount++] = STAGE_STYLE;
+        if (spec.exStyleMask) stages[stageCount++] = STAGE_EXSTYLE;
+        if (spec.unowned)     stages[stageCount++] = STAGE_OWNER;
+        if (spec.uncloaked)   stages[stageCount++] = STAGE_CLOAK;
+        if (spec.excludedClasses && !spec.excludedClasses->Empty())     stages[stageCount++] = STAGE_CLASS;
+        if (spec.excludedProcesses && !spec.excludedProcesses->Empty()) stages[stageCount++] = STAGE_PROCESS;
+        ResetCounts();
+    }
+
+    void ResetCounts() {
+        passed = 0;
+        for (auto& count : rejected) count = 0;
+    }
+
+    bool Accept(HWND hwnd, HWND owner, DWORD pid, DWORD style, DWORD exStyle) {
+        for (size_t i = 0; i < stageCount; ++i) {
+            if (!Test(stages[i], hwnd, owner, pid, style, exStyle)) {
+                rejected[stages[i]]++;
+                return false;
+            }
+        }
+        passed++;
+        return true;
+    }
+
+    bool Accept(const WindowSnapshot& snap, size_t i) {
+        return Accept(snap.hwnd[i], snap.owner[i], snap.pid[i], snap.style[i], snap.exStyle[i]);
+    }
+
+    // e.g. "12 passed; rejected: style 80, owner 31, process 6"
+    std::wstring Report() const {
+        std::wstring report = std::to_wstring(passed) + L" passed; rejected:";
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            if (rejected[s]) report += L" " + std::wstring(kStageNames[s]) + L" " + std::to_wstring(rejected[s]);
+        }
+        return report;
+    }
+
+private:
+    FilterSpec  spec;
+    FilterStage stages[STAGE_COUNT];
+    size_t      stageCount = 0;
+
+    bool Test(FilterStage stage, HWND hwnd, HWND owner, DWORD pid, DWORD style, DWORD exStyle) const {
+        switch (stage) {
+            case STAGE_STYLE:   return (style & spec.styleMask) == spec.styleValue;
+            case STAGE_EXSTYLE: return (exStyle & spec.exStyleMask) == spec.exStyleValue;
+            case STAGE_OWNER:   return !owner;
+            case STAGE_CLOAK:   return !IsWindowCloaked(hwnd);
+            case STAGE_CLASS: {
+                wchar_t className[256];
+                return !GetClassName(hwnd, className, _countof(className)) ||
+                       !spec.excludedClasses->Contains(className);
+            }
+            case STAGE_PROCESS: return !IsProcessExcluded(pid, *spec.excludedProcesses);
+            default:            return true;
+        }
+    }
+};
+
+// Only touched from the hotkey thread.
+static WindowFilter g_resizeFilter;
+
+// — Batched positioning —
+//
+// Target rects are collected first and applied in one DeferWindowPos
+// transaction per owning thread, so the desktop recomposes once per batch
+// instead of once per window. A window that rejects deferral is dropped from
+// its batch and positioned on its own; those individual calls, like moves of
+// hung windows, use SWP_ASYNCWINDOWPOS so they never wait on the target.
+
+struct WindowMove {
+    HWND  hwnd;
+    DWORD threadId;
+    DWORD processId;
+    LONG  x, y, cx, cy;
+    UINT  flags;
+};
+
+struct MoveStats {
+    size_t batches    = 0;
+    size_t individual = 0;
+    size_t hung       = 0;
+    size_t stragglers = 0;
+};
+
+// Applies one thread's moves; returns how many fell back to SetWindowPos.
+static size_t ApplyThreadBatch(const WindowMove* moves, size_t count) {
+    std::vector<bool> rejected(count);
+    size_t rejectedCount = 0;
+    bool batchFailed = false;
+    while (rejectedCount < count) {
+        HDWP hdwp = BeginDeferWindowPos((int)(count - rejectedCount));
+        if (!hdwp) {
+            batchFailed = true;
+            break;
+        }
+        size_t failedAt = count;
+        for (size_t i = 0; i < count; ++i) {
+            if (rejected[i]) continue;
+            const WindowMove& m = moves[i];
+            HDWP next = DeferWindowPos(hdwp, m.hwnd, nullptr, m.x, m.y, m.cx, m.cy, m.flags);
+            if (!next) {
+                failedAt = i;
+                break;
+            }
+            hdwp = next;
+        }
+        if (failedAt == count) {
+            batchFailed = !EndDeferWindowPos(hdwp);
             break;
         }
-        tokens.push_back(hotkeyStr.substr(start, pos - start));
-        start = pos + 1;
-    }
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        std::wstring tok = tokens[i];
-        for (auto& c : tok) c = towupper(c);
-        if (i + 1 < tokens.size()) {
-            if (tok == L"SHIFT")    modifiers |= MOD_SHIFT;
-            else if (tok == L"CTRL" || tok == L"CONTROL") modifiers |= MOD_CONTROL;
-            else if (tok == L"ALT")  modifiers |= MOD_ALT;
-            else if (tok == L"WIN" || tok == L"WINDOWS") modifiers |= MOD_WIN;
+        // A failed DeferWindowPos releases the whole structure, so retry the
+        // batch without the offending window.
+        rejected[failedAt] = true;
+        rejectedCount++;
+    }
+
+    size_t individual = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!rejected[i] && !batchFailed) continue;
+        const WindowMove& m = moves[i];
+        SetWindowPos(m.hwnd, nullptr, m.x, m.y, m.cx, m.cy, m.flags | SWP_ASYNCWINDOWPOS);
+        individual++;
+    }
+    return individual;
+}
+
+// — Positioning workers —
+//
+// Per-thread batches run on a small pool so that one slow target thread can't
+// hold up the rest, and the hotkey thread waits at most kPositioningDeadline
+// for them. Batches still running at the deadline are logged as stragglers
+// and complete in the background.
+//
+// A target that stops responding inside EndDeferWindowPos pins its worker for
+// as long as it hangs, so workers are never joined. Each one shares the pool
+// state through a shared_ptr and holds a reference on the mod's module, which
+// it drops on exit; stopping the pool only tells them to quit. Workers stuck
+// in a batch are replaced, up to kMaxPositioningWorkers, so every action still
+// finds kPositioningWorkers idle ones, and the spares retire once they return.
+
+constexpr size_t kPositioningWorkers = 4;
+constexpr size_t kMaxPositioningWorkers = 16;
+constexpr auto   kPositioningDeadline = std::chrono::milliseconds(500);
+
+struct PositioningRun {
+    std::vector<WindowMove>                moves;
+    std::vector<std::pair<size_t, size_t>> batches;   // [begin, end) into moves
+    std::vector<bool>                      done;
+    size_t                                 remaining  = 0;
+    size_t                                 individual = 0;
+};
+
+struct PositioningPoolState {
+    std::mutex mutex;
+    std::condition_variable workCv;
+    std::condition_variable doneCv;
+    std::deque<std::pair<std::shared_ptr<PositioningRun>, size_t>> queue;
+    size_t workers  = 0;    // live worker threads
+    size_t idle     = 0;    // workers not inside a batch
+    bool   stopping = false;
+};
+
+class PositioningPool {
+public:
+    void Start() {
+        state = std::make_shared<PositioningPoolState>();
+        std::lock_guard<std::mutex> lock(state->mutex);
+        for (size_t i = 0; i < kPositioningWorkers; ++i) Spawn();
+    }
+
+    // Returns without waiting: idle workers exit right away, busy ones as
+    // soon as their batch returns.
+    void Stop() {
+        if (!state) return;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->stopping = true;
+            state->queue.clear();
+        }
+        state->workCv.notify_all();
+        state.reset();
+    }
+
+    // Queues every batch of the run and waits until all are applied or the
+    // deadline passes. The run's completion state is updated under the lock,
+    // so read it through Snapshot afterwards.
+    void Run(const std::shared_ptr<PositioningRun>& run) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        while (state->idle < kPositioningWorkers && state->workers < kMaxPositioningWorkers) {
+            if (!Spawn()) break;
+        }
+        run->done.assign(run->batches.size(), false);
+        run->remaining = run->batches.size();
+        for (size_t i = 0; i < run->batches.size(); ++i) state->queue.emplace_back(run, i);
+        state->workCv.notify_all();
+        state->doneCv.wait_for(lock, kPositioningDeadline, [&] { return run->remaining == 0; });
+    }
+
+    void Snapshot(const PositioningRun& run, std::vector<bool>& done, size_t& individual) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        done = run.done;
+        individual = run.individual;
+    }
+
+private:
+    struct WorkerStart {
+        std::shared_ptr<PositioningPoolState> state;
+        HMODULE                               module;
+    };
+
+    std::shared_ptr<PositioningPoolState> state;
+
+    // Called with the state lock held.
+    bool Spawn() {
+        HMODULE module;
+        if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                               (LPCWSTR)(void*)&PositioningPool::WorkerProc, &module)) {
+            return false;
+        }
+        auto* start = new WorkerStart{ state, module };
+        HANDLE thread = CreateThread(nullptr, 0, WorkerProc, start, 0, nullptr);
+        if (!thread) {
+            Wh_Log(L"[resize-windows] failed to start a positioning worker: %u", GetLastError());
+            delete start;
+            FreeLibrary(module);
+            return false;
+        }
+        CloseHandle(thread);
+        state->workers++;
+        state->idle++;
+        return true;
+    }
+
+    static DWORD WINAPI WorkerProc(LPVOID param) {
+        HMODULE module;
+        {
+            std::unique_ptr<WorkerStart> start((WorkerStart*)param);
+            module = start->module;
+            WorkerLoop(*start->state);
+        }
+        // Keeps the module loaded until the worker is out of it.
+        FreeLibraryAndExitThread(module, 0);
+        return 0;
+    }
+
+    static void WorkerLoop(PositioningPoolState& s) {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        while (true) {
+            s.workCv.wait(lock, [&] { return s.stopping || !s.queue.empty(); });
+            if (s.stopping) break;
+            auto [run, index] = std::move(s.queue.front());
+            s.queue.pop_front();
+            s.idle--;
+            lock.unlock();
+
+            auto [begin, end] = run->batches[index];
+            size_t individual = ApplyThreadBatch(&run->moves[begin], end - begin);
+
+            lock.lock();
+            s.idle++;
+            run->done[index] = true;
+            run->individual += individual;
+            run->remaining--;
+            s.doneCv.notify_all();
+            // A replacement took over while this worker was stuck.
+            if (s.idle > kPositioningWorkers) break;
+        }
+        s.idle--;
+        s.workers--;
+    }
+};
+
+// Started and stopped with the hotkey thread.
+static PositioningPool g_positioningPool;
+
+MoveStats ApplyWindowMoves(const std::vector<WindowMove>& moves) {
+    MoveStats stats;
+    auto run = std::make_shared<PositioningRun>();
+
+    // A hung window would stall its whole batch in EndDeferWindowPos, so its
+    // move is posted asynchronously instead.
+    for (const auto& m : moves) {
+        if (IsHungAppWindow(m.hwnd)) {
+            SetWindowPos(m.hwnd, nullptr, m.x, m.y, m.cx, m.cy, m.flags | SWP_ASYNCWINDOWPOS);
+            stats.hung++;
         } else {
-            if (tok.size() == 1) {
-                vk = (UINT)tok[0];
-            } else if (tok[0] == L'F' && tok.size() > 1) {
-                int fn = _wtoi(tok.substr(1).c_str());
-                if (fn >= 1 && fn <= 24) vk = VK_F1 + fn - 1;
-            } else if (tok == L"LEFT")   vk = VK_LEFT;
-            else if (tok == L"RIGHT")    vk = VK_RIGHT;
-            else if (tok == L"UP")       vk = VK_UP;
-            else if (tok == L"DOWN")     vk = VK_DOWN;
-            else if (tok == L"TAB")      vk = VK_TAB;
-            else if (tok == L"ESC" || tok == L"ESCAPE") vk = VK_ESCAPE;
-            else if (tok == L"SPACE")    vk = VK_SPACE;
+            run->moves.push_back(m);
         }
     }
-    return vk != 0;
+
+    auto& batched = run->moves;
+    std::stable_sort(batched.begin(), batched.end(), [](const WindowMove& a, const WindowMove& b) {
+        return a.threadId < b.threadId;
+    });
+    for (size_t begin = 0, end; begin < batched.size(); begin = end) {
+        for (end = begin + 1; end < batched.size() && batched[end].threadId == batched[begin].threadId; ++end) {}
+        run->batches.emplace_back(begin, end);
+    }
+    stats.batches = run->batches.size();
+    if (run->batches.empty()) return stats;
+
+    g_positioningPool.Run(run);
+
+    std::vector<bool> done;
+    g_positioningPool.Snapshot(*run, done, stats.individual);
+    for (size_t i = 0; i < done.size(); ++i) {
+        if (done[i]) continue;
+        auto [begin, end] = run->batches[i];
+        Wh_Log(L"[resize-windows] straggler: pid %u tid %u, %zu windows still pending",
+               batched[begin].processId, batched[begin].threadId, end - begin);
+        stats.stragglers++;
+    }
+    return stats;
+}
+
+// — Undo journal —
+//
+// Every action records the pre-action placement of the windows it touches so
+// the undo hotkey can put them back. Records live in a fixed-size byte ring;
+// the oldest actions are evicted when it fills up, so memory stays bounded
+// however many windows are open. Each window is stored as varints: the rect
+// the action gave it, its previous frame rect as a delta from that, and its
+// normal (restored) rect as a delta from the frame rect. Most deltas are zero
+// or only move one edge pair, so a typical entry is a dozen bytes.
+
+constexpr size_t kJournalBytes      = 64 * 1024;
+constexpr size_t kMaxJournalActions = 32;
+
+struct JournalEntry {
+    HWND hwnd;
+    UINT showCmd;
+    RECT normal;        // WINDOWPLACEMENT::rcNormalPosition
+    RECT before;        // frame rect before the action
+    RECT after;         // rect the action applied
+};
+
+class GeometryJournal {
+public:
+    void Record(const std::vector<JournalEntry>& entries) {
+        std::vector<BYTE> bytes;
+        size_t count = 0;
+        for (const auto& e : entries) {
+            size_t mark = bytes.size();
+            PutVarint(bytes, (ULONG_PTR)e.hwnd);
+            PutVarint(bytes, e.showCmd);
+            PutRect(bytes, e.after, {});
+            PutRect(bytes, e.before, e.after);
+            PutRect(bytes, e.normal, e.before);
+            if (bytes.size() > kJournalBytes) {
+                bytes.resize(mark);
+                break;
+            }
+            count++;
+        }
+        if (!count) return;
+
+        while (actionCount && (actionCount == kMaxJournalActions || used + bytes.size() > kJournalBytes))
+            DropOldest();
+
+        Action& action = actions[(first + actionCount) % kMaxJournalActions];
+        action = { head, bytes.size(), count };
+        for (size_t i = 0; i < bytes.size(); ++i) ring[(head + i) % kJournalBytes] = bytes[i];
+        head = (head + bytes.size()) % kJournalBytes;
+        used += bytes.size();
+        actionCount++;
+    }
+
+    // Removes up to `depth` of the newest actions and returns the state
+    // before the oldest of them, one entry per window.
+    std::vector<JournalEntry> Pop(size_t depth, size_t& popped) {
+        std::vector<JournalEntry> result;
+        std::unordered_map<HWND, size_t> index;
+        for (popped = 0; popped < depth && actionCount; ++popped) {
+            const Action& action = actions[(first + actionCount - 1) % kMaxJournalActions];
+            std::vector<BYTE> bytes(action.size);
+            for (size_t i = 0; i < action.size; ++i) bytes[i] = ring[(action.offset + i) % kJournalBytes];
+
+            const BYTE* p = bytes.data();
+            const BYTE* end = p + bytes.size();
+            for (size_t i = 0; i < action.count; ++i) {
+                JournalEntry e;
+                unsigned long long hwnd, showCmd;
+                if (!GetVarint(p, end, hwnd) || !GetVarint(p, end, showCmd) ||
+                    !GetRect(p, end, e.after, {}) || !GetRect(p, end, e.before, e.after) ||
+                    !GetRect(p, end, e.normal, e.before)) {
+                    break;
+                }
+                e.hwnd = (HWND)(ULONG_PTR)hwnd;
+                e.showCmd = (UINT)showCmd;
+                // Older actions overwrite newer ones: undo restores the state
+                // from before the earliest reverted action.
+                auto [it, inserted] = index.emplace(e.hwnd, result.size());
+                if (inserted) result.push_back(e);
+                else          result[it->second] = e;
+            }
+
+            head = action.offset;
+            used -= action.size;
+            actionCount--;
+        }
+        return result;
+    }
+
+    size_t Actions() const { return actionCount; }
+    size_t BytesUsed() const { return used; }
+
+private:
+    struct Action {
+        size_t offset, size, count;
+    };
+
+    BYTE   ring[kJournalBytes];
+    Action actions[kMaxJournalActions];
+    size_t first = 0, actionCount = 0;
+    size_t head = 0, used = 0;
+
+    void DropOldest() {
+        used -= actions[first].size;
+        first = (first + 1) % kMaxJournalActions;
+        actionCount--;
+    }
+
+    static void PutVarint(std::vector<BYTE>& out, unsigned long long v) {
+        for (; v >= 0x80; v >>= 7) out.push_back(BYTE(v | 0x80));
+        out.push_back(BYTE(v));
+    }
+
+    static bool GetVarint(const BYTE*& p, const BYTE* end, unsigned long long& v) {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            BYTE b = *p++;
+            v |= (unsigned long long)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Zigzag-encoded so small negative deltas stay short.
+    static void PutRect(std::vector<BYTE>& out, const RECT& r, const RECT& base) {
+        for (LONG d : { r.left - base.left, r.top - base.top, r.right - base.right, r.bottom - base.bottom }) {
+            int v = (int)d;
+            PutVarint(out, ((unsigned)v << 1) ^ (unsigned)(v >> 31));
+        }
+    }
+
+    static bool GetRect(const BYTE*& p, const BYTE* end, RECT& r, const RECT& base) {
+        LONG d[4];
+        for (auto& value : d) {
+            unsigned long long zz;
+            if (!GetVarint(p, end, zz)) return false;
+            value = (LONG)((int)(zz >> 1) ^ -(int)(zz & 1));
+        }
+        r = { base.left + d[0], base.top + d[1], base.right + d[2], base.bottom + d[3] };
+        return true;
+    }
+};
+
+// Only touched from the hotkey thread.
+static GeometryJournal g_journal;
+static size_t          g_undoDepth = 1;
+
+// Builds a journal entry from the window's current placement.
+static bool CaptureJournalEntry(HWND hwnd, const RECT& after, JournalEntry& e) {
+    WINDOWPLACEMENT wp = { sizeof(wp) };
+    if (!GetWindowPlacement(hwnd, &wp) || !GetWindowRect(hwnd, &e.before)) return false;
+    e.hwnd = hwnd;
+    e.showCmd = wp.showCmd;
+    e.normal = wp.rcNormalPosition;
+    e.after = after;
+    return true;
+}
+
+// Maximized and minimized windows go back through SetWindowPlacement, which
+// can't be deferred; returns false for entries left to the batched path.
+static bool RestorePlacement(const JournalEntry& e) {
+    if (e.showCmd != SW_SHOWMAXIMIZED && e.showCmd != SW_SHOWMINIMIZED) return false;
+    WINDOWPLACEMENT wp = { sizeof(wp) };
+    GetWindowPlacement(e.hwnd, &wp);
+    wp.flags = WPF_ASYNCWINDOWPLACEMENT;
+    wp.showCmd = e.showCmd == SW_SHOWMINIMIZED ? SW_SHOWMINNOACTIVE : e.showCmd;
+    wp.rcNormalPosition = e.normal;
+    SetWindowPlacement(e.hwnd, &wp);
+    return true;
+}
+
+enum {
+    ACTION_RESIZE_ALL,
+    ACTION_UNDO,
+    ACTION_DUMP_TIMINGS,
+};
+
+static HotkeyDispatcher g_dispatcher;
+static bool             g_allowChords;
+
+// Binds the chord from a hotkey setting. An empty setting leaves the action
+// unbound; an unparsable one falls back to `fallback` when one is given.
+static void BindHotkeySetting(PCWSTR name, PCWSTR fallback, int action) {
+    HotkeyChord chord;
+    bool bound = false;
+    PCWSTR setting = Wh_GetStringSetting(name);
+    if (setting && *setting && ParseHotkey(setting, chord)) {
+        Wh_Log(L"[resize-windows] using %s: %s", name, setting);
+        bound = true;
+    } else if (fallback) {
+        Wh_Log(L"[resize-windows] failed to parse %s '%s', using default %s", name, setting ? setting : L"", fallback);
+        bound = ParseHotkey(fallback, chord);
+    } else if (setting && *setting) {
+        Wh_Log(L"[resize-windows] failed to parse %s '%s', leaving it unbound", name, setting);
+    }
+    if (bound && chord.count > 1 && !g_allowChords) {
+        Wh_Log(L"[resize-windows] %s is a chord, leaving it unbound until chords are allowed", name);
+        bound = false;
+    }
+    if (setting) Wh_FreeStringSetting(setting);
+    if (bound && !g_dispatcher.Add(chord, action))
+        Wh_Log(L"[resize-windows] %s conflicts with another hotkey", name);
 }
 
 void ResizeAllWindows();
+void UndoLastActions();
 void HotkeyThreadProc();
 
 // — Windhawk entry/exit —
 
+// Reads every setting into the globals. Runs in Wh_ModInit before the hotkey
+// thread starts and afterwards only on that thread, so nothing it touches
+// needs a lock.
+void LoadSettings() {
+    g_dispatcher.Clear();
+    g_allowChords = Wh_GetIntSetting(L"AllowChords") != 0;
+    BindHotkeySetting(L"Hotkey", kDefaultHotkey, ACTION_RESIZE_ALL);
+    BindHotkeySetting(L"UndoHotkey", nullptr, ACTION_UNDO);
+    BindHotkeySetting(L"DiagnosticsHotkey", nullptr, ACTION_DUMP_TIMINGS);
+    g_undoDepth = (size_t)std::clamp(Wh_GetIntSetting(L"UndoDepth"), 1, (int)kMaxJournalActions);
+    g_excludedProcesses.Build(LoadStringList(L"ExcludedProcesses"));
+    g_excludedClasses.Build(LoadStringList(L"ExcludedWindowClasses"));
+    FilterSpec spec;
+    spec.styleMask = WS_VISIBLE | WS_MINIMIZE | WS_MAXIMIZE;
+    spec.styleValue = WS_VISIBLE;
+    spec.unowned = spec.uncloaked = true;
+    spec.excludedClasses = &g_excludedClasses;
+    spec.excludedProcesses = &g_excludedProcesses;
+    g_resizeFilter.Compile(spec);
+    Wh_Log(L"[resize-windows] excluding %zu processes, %zu window classes",
+           g_excludedProcesses.Size(), g_excludedClasses.Size());
+    LoadBreakpoints({ 1440, 800 });
+}
+
 BOOL Wh_ModInit() {
     Wh_Log(L"[resize-windows] initializing...");
-    // Load user-configured hotkey
-    PCWSTR setting = Wh_GetStringSetting(L"Hotkey");
-    if (setting) {
-        std::wstring s = setting;
-        Wh_FreeStringSetting(setting);
-        UINT mods = 0, vk = 0;
-        if (ParseHotkey(s, mods, vk)) {
-            g_hotkeyModifiers = mods;
-            g_hotkeyVk        = vk;
-            Wh_Log(L"[resize-windows] using hotkey: %s", s.c_str());
-        } else {
-            Wh_Log(L"[resize-windows] failed to parse '%s', using default Ctrl+Shift+Alt+F5", s.c_str());
-        }
-    }
+    LoadSettings();
     g_running = true;
     g_hotkeyThread = std::thread(HotkeyThreadProc);
     return TRUE;
@@ -137,8 +1560,11 @@ void Wh_ModUninit() {
     Wh_Log(L"[resize-windows] shutdown complete");
 }
 
+// Settings are applied in place by the hotkey thread, so the hotkeys stay
+// live; a full reload is only needed if its window doesn't exist yet.
 BOOL Wh_ModSettingsChanged(BOOL* bReload) {
-    *bReload = TRUE;
+    HWND hwnd = g_msgWindow.load();
+    *bReload = !hwnd || !PostMessage(hwnd, WM_APP_RELOAD_SETTINGS, 0, 0);
     return TRUE;
 }
 
@@ -161,64 +1587,139 @@ void HotkeyThreadProc() {
     }
     g_msgWindow = hwnd;
 
-    if (!RegisterHotKey(hwnd, HOTKEY_ID, g_hotkeyModifiers, g_hotkeyVk))
-        Wh_Log(L"[resize-windows] failed to register hotkey: %u", GetLastError());
-    else
-        Wh_Log(L"[resize-windows] Hotkey registered (mod=0x%X vk=0x%X)", g_hotkeyModifiers, g_hotkeyVk);
+    g_dispatcher.Register(hwnd);
+    g_positioningPool.Start();
 
     MSG msg;
     while (g_running && GetMessage(&msg, hwnd, 0, 0) > 0) {
-        if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_ID) {
-            Wh_Log(L"[resize-windows] hotkey pressed → resizing windows");
-            ResizeAllWindows();
+        if (msg.message == WM_HOTKEY) {
+            LONGLONG received = QpcNow();
+            int action = g_dispatcher.OnHotkey(hwnd, msg.lParam);
+            switch (action) {
+                case ACTION_RESIZE_ALL:
+                    g_timing.Start(L"resize", received);
+                    Wh_Log(L"[resize-windows] hotkey pressed → resizing windows");
+                    ResizeAllWindows();
+                    break;
+                case ACTION_DUMP_TIMINGS:
+                    g_timings.Dump();
+                    break;
+                case ACTION_UNDO:
+                    Wh_Log(L"[resize-windows] undo hotkey pressed → restoring windows");
+                    UndoLastActions();
+                    break;
+            }
+        } else if (msg.message == WM_TIMER && msg.wParam == CHORD_TIMER_ID) {
+            g_dispatcher.OnTimeout(hwnd);
+        } else if (msg.message == WM_APP_PROCESS_EXITED) {
+            g_processCache.OnExited((DWORD)msg.wParam);
+        } else if (msg.message == WM_APP_RELOAD_SETTINGS) {
+            // Swap the registrations in place; the thread and window stay.
+            g_dispatcher.Unregister(hwnd);
+            LoadSettings();
+            g_dispatcher.Register(hwnd);
+            Wh_Log(L"[resize-windows] settings reloaded");
         }
     }
 
-    UnregisterHotKey(hwnd, HOTKEY_ID);
+    g_dispatcher.Unregister(hwnd);
+    g_positioningPool.Stop();
     DestroyWindow(hwnd);
     UnregisterClass(wc.lpszClassName, wc.hInstance);
     g_msgWindow = nullptr;
+    g_processCache.Clear();
     Wh_Log(L"[resize-windows] message thread exiting");
 }
 
 // — Helpers to enumerate & resize windows —
 
-void ResizeWindow(HWND hwnd) {
-    DWORD pid = 0;
-    GetWindowThreadProcessId(hwnd, &pid);
-    if (pid) {
-        HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
-        if (hProc) {
-            wchar_t fullPath[MAX_PATH] = {};
-            DWORD size = _countof(fullPath);
-            if (QueryFullProcessImageName(hProc, 0, fullPath, &size)) {
-                const wchar_t* exe = wcsrchr(fullPath, L'\\');
-                exe = exe ? exe + 1 : fullPath;
-                // Skip Start menu, Shell Experience Host, Search UI and Search Host
-                if (_wcsicmp(exe, L"ShellExperienceHost.exe") == 0 ||
-                    _wcsicmp(exe, L"StartMenuExperienceHost.exe") == 0 ||
-                    _wcsicmp(exe, L"SearchApp.exe") == 0 ||
-                    _wcsicmp(exe, L"SearchUI.exe") == 0 ||
-                    _wcsicmp(exe, L"SearchHost.exe") == 0 ||
-                    _wcsicmp(exe, L"Rainlendar2.exe") == 0) {
-                    CloseHandle(hProc);
-                    return;
-                }
-            }
-            CloseHandle(hProc);
-        }
+// Windows passing the filter, each sized for its monitor from `sizes` (one
+// per monitor).
+void CollectResizes(const WindowSnapshot& snap, const std::vector<SIZE>& sizes, std::vector<WindowMove>& moves) {
+    for (size_t i = 0; i < snap.Size(); ++i) {
+        if (!g_resizeFilter.Accept(snap, i)) continue;
+        SIZE size = sizes[snap.monitor[i]];
+        moves.push_back({ snap.hwnd[i], snap.tid[i], snap.pid[i], snap.rect[i].left, snap.rect[i].top,
+                          size.cx, size.cy, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE });
     }
-    if (!IsWindowVisible(hwnd) || IsIconic(hwnd) || IsZoomed(hwnd)) return;
-    if (GetWindow(hwnd, GW_OWNER) != nullptr) return;
+}
 
-    SetWindowPos(hwnd, nullptr, 0, 0, 1440, 800, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+// Snapshot the pre-action placement of every window about to be moved.
+void JournalMoves(const std::vector<WindowMove>& moves) {
+    std::vector<JournalEntry> entries;
+    entries.reserve(moves.size());
+    for (const auto& m : moves) {
+        JournalEntry e;
+        if (CaptureJournalEntry(m.hwnd, { m.x, m.y, m.x + m.cx, m.y + m.cy }, e))
+            entries.push_back(e);
+    }
+    g_journal.Record(entries);
 }
 
-BOOL CALLBACK EnumProc(HWND hwnd, LPARAM lp) {
-    ResizeWindow(hwnd);
-    return TRUE;
+void UndoLastActions() {
+    size_t popped = 0;
+    std::vector<JournalEntry> entries = g_journal.Pop(g_undoDepth, popped);
+
+    std::vector<WindowMove> moves;
+    size_t placements = 0;
+    for (const auto& e : entries) {
+        if (!IsWindow(e.hwnd)) continue;
+        if (RestorePlacement(e)) {
+            placements++;
+            continue;
+        }
+        DWORD pid = 0;
+        DWORD tid = GetWindowThreadProcessId(e.hwnd, &pid);
+        moves.push_back({ e.hwnd, tid, pid, e.before.left, e.before.top,
+                          e.before.right - e.before.left, e.before.bottom - e.before.top,
+                          SWP_NOZORDER | SWP_NOACTIVATE });
+    }
+    MoveStats stats = ApplyWindowMoves(moves);
+
+    Wh_Log(L"[resize-windows] undo: reverted %zu actions, %zu windows in %zu batches, %zu placements; %zu actions (%zu bytes) left",
+           popped, moves.size(), stats.batches, placements, g_journal.Actions(), g_journal.BytesUsed());
 }
 
+// Only touched from the hotkey thread.
+static size_t g_nextBreakpoint = 0;
+
+// Each press applies the next breakpoint. Sizes are worked out once per
+// monitor before any window is touched.
 void ResizeAllWindows() {
-    EnumWindows(EnumProc, 0);
+    g_timing.Mark(PHASE_DISPATCH);
+    g_resizeFilter.ResetCounts();
+
+    MonitorTable monitors = BuildMonitorTable();
+    if (monitors.handles.empty()) return;
+    g_timing.Mark(PHASE_ENUMERATE);
+    size_t breakpoint = g_nextBreakpoint % g_breakpoints.size();
+    g_nextBreakpoint = breakpoint + 1;
+    std::vector<SIZE> sizes(monitors.geometry.size());
+    for (size_t m = 0; m < sizes.size(); ++m)
+        sizes[m] = ScaleBreakpoint(g_breakpoints[breakpoint], monitors.geometry[m].dpi, monitors.geometry[m].work);
+    g_timing.Mark(PHASE_LAYOUT);
+
+    WindowSnapshot snap = CaptureWindowSnapshot(DesktopWindowSource{});
+    snap.AssignMonitors([&](const RECT& r) { return monitors.IndexOfRect(r); });
+    g_timing.Mark(PHASE_ENUMERATE);
+    std::vector<WindowMove> moves;
+    LONGLONG queryTicks = g_processCache.queryTicks;
+    CollectResizes(snap, sizes, moves);
+    g_timing.Mark(PHASE_FILTER);
+    g_timing.Shift(PHASE_FILTER, PHASE_PROCESS_QUERY, g_processCache.queryTicks - queryTicks);
+    JournalMoves(moves);
+    g_timing.Mark(PHASE_JOURNAL);
+    MoveStats stats = ApplyWindowMoves(moves);
+    g_timing.Mark(PHASE_POSITION);
+    g_timing.windows = snap.Size();
+    g_timing.moved = moves.size();
+    g_timings.Push(g_timing);
+
+    Wh_Log(L"[resize-windows] resized %zu windows to %ldx%ld in %zu batches (%zu individually, %zu hung, %zu stragglers)",
+           moves.size(), g_breakpoints[breakpoint].cx, g_breakpoints[breakpoint].cy,
+           stats.batches, stats.individual, stats.hung, stats.stragglers);
+    Wh_Log(L"[resize-windows] filter: %s", g_resizeFilter.Report().c_str());
+    Wh_Log(L"[resize-windows] took %lld us from the hotkey", (long long)(g_timing.Total() * 1000000 / QpcFrequency()));
+    Wh_Log(L"[resize-windows] process cache: %u hits, %u misses, %u evicted, %zu live",
+           g_processCache.hits, g_processCache.misses, g_processCache.evictions, g_processCache.Size());
 }